@@ -0,0 +1,285 @@
+#include <cassert>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "../processing/processing.h"
+#include "../core/hash_key.h"
+#include "../core/window.h"
+#include "../utils/timer.h"
+#include "../utils/thread_pool.h"
+
+/**
+ * Micro-benchmarks of the hot kernels, run on synthetic frames generated from a fixed seed, so results are
+ * comparable between runs and machines and no T-LESS data is needed. Every benchmark is calibrated to run
+ * at least SAMPLE_SECONDS per sample and median of SAMPLES samples is reported.
+ *
+ * Usage: vsb-semestral-project-benchmark [filter] [threads], runs only benchmarks whose name contains filter,
+ * kernels run on a single thread by default (0 for all hardware threads).
+ */
+namespace {
+    const int SAMPLES = 9;
+    const double SAMPLE_SECONDS = 0.05;
+    const uint64 SEED = 0x7e55;
+
+    /**
+     * @brief Native depth resolution and focal length of sensors used in T-LESS (RGB is registered to depth).
+     */
+    struct Sensor {
+        const char *name;
+        cv::Size size;
+        float fx, fy;
+    };
+
+    const Sensor SENSORS[] = {
+        {"primesense", cv::Size(640, 480), 575.8f, 575.8f},
+        {"kinectv2", cv::Size(512, 424), 365.5f, 365.5f},
+    };
+
+    struct Frame {
+        cv::Mat rgb, gray, hsv, depth;
+    };
+
+    volatile size_t sink = 0; //!< Keeps results of scalar benchmarks alive
+
+    /**
+     * @brief Generates table plane with boxes and spheres standing on it, with sensor noise and missing depth.
+     */
+    Frame syntheticFrame(const Sensor &sensor) {
+        cv::RNG rng(SEED);
+        const cv::Size size = sensor.size;
+        Frame frame;
+
+        // Table plane tilted away from the camera, 700-1100 mm
+        cv::Mat depth(size, CV_32FC1);
+        cv::Mat rgb(size, CV_8UC3);
+        for (int y = 0; y < size.height; y++) {
+            for (int x = 0; x < size.width; x++) {
+                depth.at<float>(y, x) = 1100.0f - 400.0f * y / size.height + 0.1f * (x - size.width / 2);
+                rgb.at<cv::Vec3b>(y, x) = cv::Vec3b(static_cast<uchar>(90 + 60 * x / size.width), 110, static_cast<uchar>(120 + 60 * y / size.height));
+            }
+        }
+
+        // Boxes with random colors, including black and white ones (remapped in normalizeHSV)
+        for (int i = 0; i < 10; i++) {
+            cv::Rect box(rng.uniform(0, size.width - 60), rng.uniform(0, size.height - 60), rng.uniform(30, 120), rng.uniform(30, 120));
+            box &= cv::Rect(cv::Point(0, 0), size);
+            const float front = rng.uniform(550.0f, 850.0f);
+            const cv::Scalar color = (i % 5 == 0) ? cv::Scalar::all(i % 2 ? 240 : 15) : cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+
+            depth(box).setTo(front);
+            rgb(box).setTo(color);
+        }
+
+        // Spheres, giving smoothly changing surface normals
+        for (int i = 0; i < 6; i++) {
+            const cv::Point c(rng.uniform(0, size.width), rng.uniform(0, size.height));
+            const int r = rng.uniform(20, 70);
+            const float center = rng.uniform(550.0f, 850.0f);
+            const cv::Vec3b color(static_cast<uchar>(rng.uniform(0, 256)), static_cast<uchar>(rng.uniform(0, 256)), static_cast<uchar>(rng.uniform(0, 256)));
+
+            for (int y = std::max(0, c.y - r); y < std::min(size.height, c.y + r); y++) {
+                for (int x = std::max(0, c.x - r); x < std::min(size.width, c.x + r); x++) {
+                    const int d2 = (x - c.x) * (x - c.x) + (y - c.y) * (y - c.y);
+                    if (d2 >= r * r) continue;
+
+                    // Radius in pixels roughly corresponds to mm at this depth for both sensors
+                    depth.at<float>(y, x) = center - std::sqrt(static_cast<float>(r * r - d2)) * center / sensor.fx;
+                    rgb.at<cv::Vec3b>(y, x) = color;
+                }
+            }
+        }
+
+        // Sensor noise and missing measurements
+        cv::Mat noise(size, CV_32FC1);
+        rng.fill(noise, cv::RNG::NORMAL, 0, 2);
+        depth += noise;
+        depth.convertTo(frame.depth, CV_16UC1);
+        for (int i = 0; i < size.area() / 50; i++) {
+            frame.depth.at<ushort>(rng.uniform(0, size.height), rng.uniform(0, size.width)) = 0;
+        }
+
+        cv::Mat rgbNoise(size, CV_16SC3), rgb16;
+        rng.fill(rgbNoise, cv::RNG::NORMAL, 0, 6);
+        rgb.convertTo(rgb16, CV_16SC3);
+        rgb16 += rgbNoise;
+        rgb16.convertTo(frame.rgb, CV_8UC3);
+
+        cv::cvtColor(frame.rgb, frame.gray, CV_BGR2GRAY);
+        cv::cvtColor(frame.rgb, frame.hsv, CV_BGR2HSV);
+
+        return frame;
+    }
+
+    /**
+     * @brief Returns median time of one operation [ns], fun is called repeatedly and performs ops operations per call.
+     */
+    template<typename Fun>
+    double measure(Fun fun, size_t ops) {
+        // Warm up caches and buffers, then find number of calls that takes at least SAMPLE_SECONDS
+        fun();
+        size_t calls = 1;
+        for (;;) {
+            tless::Timer t;
+            for (size_t i = 0; i < calls; i++) fun();
+            if (t.elapsed() >= SAMPLE_SECONDS) break;
+            calls *= 2;
+        }
+
+        std::vector<double> samples(SAMPLES);
+        for (auto &sample : samples) {
+            tless::Timer t;
+            for (size_t i = 0; i < calls; i++) fun();
+            sample = t.elapsed() * 1e9 / (calls * ops);
+        }
+
+        std::nth_element(samples.begin(), samples.begin() + SAMPLES / 2, samples.end());
+        return samples[SAMPLES / 2];
+    }
+
+    void report(const std::string &name, const std::string &input, double ns, int pixels = 0) {
+        std::cout << "  |_ " << std::left << std::setw(20) << name << std::setw(28) << input << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(14) << ns << " ns/op";
+        if (pixels > 0) {
+            std::cout << std::setw(12) << pixels / ns * 1e3 << " Mpix/s";
+        }
+        std::cout << std::endl;
+    }
+
+    bool selected(const std::string &name, const std::string &filter) {
+        return name.find(filter) != std::string::npos;
+    }
+
+    void benchmarkKernels(const Sensor &sensor, const std::string &filter) {
+        const Frame frame = syntheticFrame(sensor);
+        const std::string input = std::string(sensor.name) + " " + std::to_string(sensor.size.width) + "x" + std::to_string(sensor.size.height);
+        const int pixels = sensor.size.area();
+        cv::Mat dst, buffer, gradX, gradY, bgr[3], mags[3], angles[3];
+
+        if (selected("quantizedNormals", filter)) {
+            report("quantizedNormals", input, measure([&]() {
+                tless::quantizedNormals(frame.depth, dst, sensor.fx, sensor.fy, 1500, 100, buffer);
+            }, 1), pixels);
+        }
+
+        if (selected("depthEdgels", filter)) {
+            report("depthEdgels", input, measure([&]() {
+                tless::depthEdgels(frame.depth, dst, 400, 1500, 50);
+            }, 1), pixels);
+        }
+
+        if (selected("quantizedGradients", filter)) {
+            report("quantizedGradients", input, measure([&]() {
+                tless::quantizedGradients(frame.rgb, dst, 100, bgr, gradX, gradY, mags, angles);
+            }, 1), pixels);
+        }
+
+        if (selected("normalizeHSV", filter)) {
+            report("normalizeHSV", input, measure([&]() {
+                tless::normalizeHSV(frame.hsv, dst);
+            }, 1), pixels);
+        }
+
+        if (selected("filterEdges", filter)) {
+            report("filterEdges", input, measure([&]() {
+                tless::filterEdges(frame.gray, dst);
+            }, 1), pixels);
+        }
+
+        // Clusters of overlapping matches around objects in the scene, as produced by template matching
+        if (selected("nms", filter)) {
+            cv::RNG rng(SEED);
+            std::vector<tless::Match> matches;
+            for (int i = 0; i < 20; i++) {
+                const cv::Point c(rng.uniform(50, sensor.size.width - 50), rng.uniform(50, sensor.size.height - 50));
+                for (int j = 0; j < 25; j++) {
+                    const int w = rng.uniform(40, 90), h = rng.uniform(40, 90);
+                    const float score = rng.uniform(0.6f, 1.0f);
+                    cv::Rect bb(c.x - w / 2 + rng.uniform(-10, 10), c.y - h / 2 + rng.uniform(-10, 10), w, h);
+                    matches.emplace_back(nullptr, bb, 1.0f, score, score * bb.area(), 0, 0, 0, 0, 0);
+                }
+            }
+
+            report("nms", input + " " + std::to_string(matches.size()) + " matches", measure([&]() {
+                std::vector<tless::Match> m = matches;
+                tless::nms(m, 0.1f);
+                sink += m.size();
+            }, 1));
+        }
+    }
+
+    void benchmarkScalars(const std::string &filter) {
+        const int N = 4096;
+        cv::RNG rng(SEED);
+
+        if (selected("quantizeDepth", filter)) {
+            const std::vector<cv::Range> ranges = {{-65536, -40}, {-40, -10}, {-10, 10}, {10, 40}, {40, 65536}};
+            std::vector<int> depths(N);
+            for (auto &d : depths) {
+                d = cvRound(rng.gaussian(50));
+            }
+
+            report("quantizeDepth", "5 bins", measure([&]() {
+                size_t sum = 0;
+                for (int d : depths) sum += tless::quantizeDepth(d, ranges);
+                sink += sum;
+            }, N));
+        }
+
+        if (selected("HashKey::hash", filter)) {
+            std::vector<tless::HashKey> keys(N);
+            for (auto &k : keys) {
+                k = tless::HashKey(tless::DEPTH_LUT[rng.uniform(0, 5)], tless::DEPTH_LUT[rng.uniform(0, 5)],
+                                   static_cast<uchar>(1 << rng.uniform(0, 8)), static_cast<uchar>(1 << rng.uniform(0, 8)),
+                                   static_cast<uchar>(1 << rng.uniform(0, 8)));
+            }
+
+            report("HashKey::hash", "one-hot keys", measure([&]() {
+                size_t sum = 0;
+                for (const auto &k : keys) sum += k.hash();
+                sink += sum;
+            }, N));
+        }
+
+        // Votes of one window: templates with growing number of votes, pushed as they are counted in verifyCandidates
+        if (selected("pushUnique", filter)) {
+            std::vector<std::pair<uint, int>> votes(N);
+            std::vector<int> counts(1000, 0);
+            for (auto &v : votes) {
+                const uint index = static_cast<uint>(rng.uniform(0, 1000));
+                v = {index, ++counts[index]};
+            }
+
+            std::vector<tless::Candidate> candidates;
+            candidates.reserve(100);
+            report("pushUnique", "N=100", measure([&]() {
+                candidates.clear();
+                for (const auto &v : votes) tless::pushUnique(candidates, v.first, v.second, 100, 3);
+                sink += candidates.size();
+            }, N));
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const std::string filter = argc > 1 ? argv[1] : "";
+    const int threads = argc > 2 ? std::stoi(argv[2]) : 1;
+    assert(threads >= 0);
+
+    // OpenCV treats 0 threads as disabled threading, so all hardware threads are passed explicitly
+    tless::ThreadPool::configureGlobal(static_cast<size_t>(threads));
+    cv::setNumThreads(threads > 0 ? threads : std::max<int>(std::thread::hardware_concurrency(), 1));
+
+    std::cout << "Benchmarking (" << tless::ThreadPool::global().size() << " threads, median of " << SAMPLES << " samples)... " << std::endl;
+    for (const auto &sensor : SENSORS) {
+        benchmarkKernels(sensor, filter);
+    }
+
+    benchmarkScalars(filter);
+
+    return 0;
+}
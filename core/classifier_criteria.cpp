@@ -12,6 +12,23 @@ namespace tless {
         os << "  |_ minMagnitude: " << crit.minMagnitude << std::endl;
         os << "  |_ maxDepthDiff: " << crit.maxDepthDiff << std::endl;
         os << "  |_ depthDeviationFun (size): " << crit.depthDeviationFun.size() << std::endl;
+        os << "  |_ threads: " << crit.threads << std::endl;
+        os << "  |_ pinThreads: " << crit.pinThreads << std::endl;
+        os << "  |_ preScaledTemplates: " << crit.preScaledTemplates << std::endl;
+        os << "  |_ depthScaledWindows: " << crit.depthScaledWindows << std::endl;
+        os << "  |_ pyrPruneLevels: " << crit.pyrPruneLevels << std::endl;
+        os << "  |_ pyrMinCoverage: " << crit.pyrMinCoverage << std::endl;
+        os << "  |_ pyrLazyFeatures: " << crit.pyrLazyFeatures << std::endl;
+        os << "  |_ pyrPooledFeatures: " << crit.pyrPooledFeatures << std::endl;
+        os << "  |_ pyrPooledAccuracy: " << crit.pyrPooledAccuracy << std::endl;
+        os << "  |_ pyrHugePages: " << crit.pyrHugePages << std::endl;
+        os << "  |_ coarseToFine: " << crit.coarseToFine << std::endl;
+        os << "  |_ coarseLevels: " << crit.coarseLevels << std::endl;
+        os << "  |_ coarseMatchFactor: " << crit.coarseMatchFactor << std::endl;
+        os << "  |_ prefetchFrames: " << crit.prefetchFrames << std::endl;
+        os << "  |_ cascadeStats: " << crit.cascadeStats << std::endl;
+        os << "  |_ metricsPath: " << crit.metricsPath << std::endl;
+        os << "  |_ tracePath: " << crit.tracePath << std::endl;
         os << "  |_ minVotes: " << crit.minVotes << std::endl;
         os << "  |_ windowStep: " << crit.windowStep << std::endl;
         os << "  |_ patchOffset: " << crit.patchOffset << std::endl;
@@ -25,6 +42,7 @@ namespace tless {
         os << "  |_ maxDepth: " << crit.info.maxDepth << std::endl;
         os << "  |_ smallestDiameter: " << crit.info.smallestDiameter << std::endl;
         os << "  |_ minEdgels: " << crit.info.minEdgels << std::endl;
+        os << "  |_ medianDepth: " << crit.info.medianDepth << std::endl;
         os << "  |_ depthScaleFactor: " << crit.info.depthScaleFactor << std::endl;
         os << "  |_ smallestTemplate: " << crit.info.smallestTemplate.width << "x" << crit.info.smallestTemplate.height
            << std::endl;
@@ -1,6 +1,7 @@
 #ifndef VSB_SEMESTRAL_PROJECT_CLASSIFIER_CRITERIA_H
 #define VSB_SEMESTRAL_PROJECT_CLASSIFIER_CRITERIA_H
 
+#include <string>
 #include <opencv2/core/cvstd.hpp>
 #include <opencv2/core/types.hpp>
 #include <opencv2/core/persistence.hpp>
@@ -24,10 +25,29 @@ namespace tless {
         // TODO fix deviation function based on the other paper
         std::vector<cv::Vec2f> depthDeviationFun{{10000, 0.14f}, {15000, 0.12f}, {20000, 0.1f}, {70000, 0.08f}}; //!< Depth error function, allowing depth values to be match within given interval
 
+        // Execution Params
+        int threads = 0; //!< Number of threads of the shared thread pool including calling thread (0 for all hardware threads, 1 to run everything on calling thread)
+        bool pinThreads = false; //!< Pin each thread pool worker to its own CPU core (Linux only)
+
         // Detect Params
         float pyrScaleFactor = 1.25f; //!< Scale factor for building scene image pyramid
         int pyrLvlsUp = 4; //!< Number of pyramid levels that are larger than input image
         int pyrLvlsDown = 4; //!< Number of pyramid levels that are smaller than input image
+        bool preScaledTemplates = false; //!< Match templates pre-scaled for each pyramid scale (built at load) against full resolution scene instead of building image pyramid
+        bool depthScaledWindows = false; //!< Detect on full resolution scene only, window sizes and feature point offsets are scaled by scene depth instead of building image pyramid
+        bool pyrPruneLevels = false; //!< Skip pyramid levels that can't contain any object based on scene depth histogram and trained depth range
+        float pyrMinCoverage = 0.3f; //!< Amount of smallest template area scene must have in trained depth range (after rescaling) to process pyramid level
+        bool pyrLazyFeatures = true; //!< Derived images of pyramid levels are computed only when and where classification needs them
+        bool pyrPooledFeatures = false; //!< Quantized normals and gradients of smaller pyramid levels are pooled from the finer level instead of recomputed (requires pyrLazyFeatures = false, ignored otherwise)
+        bool pyrPooledAccuracy = false; //!< Print agreement of pooled features with recomputed ones for each parsed scene (only with pyrPooledFeatures, recomputes features of all levels)
+        bool pyrHugePages = false; //!< Back reusable scene pyramid buffers by transparent huge pages (Linux only, each buffer is rounded up to 2MB)
+        bool coarseToFine = false; //!< Finer pyramid levels are searched only around candidates found on coarser levels
+        int coarseLevels = 2; //!< Number of smallest pyramid levels searched exhaustively in coarse-to-fine search
+        float coarseMatchFactor = 0.4f; //!< Loose matchFactor for tests I-III used to collect seeds for finer levels in coarse-to-fine search
+        int prefetchFrames = 2; //!< Number of frames loaded and preprocessed in background ahead of the matched frame when detecting on frame source (0 to disable)
+        bool cascadeStats = false; //!< Collect statistics of tests I-V of template matching per level and object (printed at the end of detection on frame source)
+        std::string tracePath; //!< Path of Chrome trace-event JSON with timeline of all threads written at the end of detection on frame source (empty to disable)
+        std::string metricsPath; //!< Base path of metrics dumps (.json and .csv) written at the end of detection on frame source and on SIGUSR1 (empty to disable)
         int minVotes = 3; //!< Minimum amount of votes to classify template as a valid candidate for given window
         int windowStep = 5; //!< Objectness sliding window step
         int patchOffset = 2; //!< +-offset, defining neighbourhood to look for a feature point match
@@ -42,6 +62,7 @@ namespace tless {
             int minEdgels = std::numeric_limits<int>::max(); //!< Minimum number of edgels found in any template
             float depthScaleFactor = 10.0f; //!< Depth scaling factor to convert depth value to millimeters
             float smallestDiameter = std::numeric_limits<float>::max(); //!< Smallest physical diameter of object in database (in mm)
+            ushort medianDepth = 0; //!< Median of depth medians of all templates (computed when trained templates are loaded)
             cv::Size smallestTemplate{500, 500}; //!< Size of the largest template found across all templates
             cv::Size largestArea{0, 0}; //!< Size of the largest area (largest width and largest height) found across all templates
         } info;
@@ -23,24 +23,33 @@ namespace tless {
                << (i + 1 == table.binRanges.size() ? ">" : ")") << std::endl;
         }
 
-        os << "Table contents: (d1, d2, n1, n2, n3)" << std::endl;
-        for (const auto &entry : table.templates) {
-            /*os << "  |_ " << entry.first << " : (";
-            for (const auto &item : entry.second) {
+        os << "Table contents: (key : template ids)" << std::endl;
+        for (size_t key = 0; key < table.templates.size(); ++key) {
+            if (table.templates[key].empty()) continue;
+
+            os << "  |_ " << key << " : (";
+            for (const auto &item : table.templates[key]) {
                 os << item->id << ", ";
             }
-            os << ")" << std::endl;*/
+            os << ")" << std::endl;
         }
 
         return os;
     }
 
-    HashTable HashTable::load(cv::FileNode &node, std::vector<Template> &templates) {
-        HashTable table;
+    std::unordered_map<uint, size_t> HashTable::indexTemplates(const std::vector<Template> &templates) {
+        std::unordered_map<uint, size_t> indices;
+        indices.reserve(templates.size());
+
+        for (size_t i = 0; i < templates.size(); ++i) {
+            indices[templates[i].id] = i;
+        }
 
-        int size;
-        node["size"] >> size;
-        table.size = static_cast<size_t>(size);
+        return indices;
+    }
+
+    bool HashTable::load(cv::FileNode &node, std::vector<Template> &templates,
+                         const std::unordered_map<uint, size_t> &indices, HashTable &table) {
         node["binRanges"] >> table.binRanges;
 
         cv::FileNode tripletNode = node["triplet"];
@@ -48,36 +57,43 @@ namespace tless {
         tripletNode["p2"] >> table.triplet.p2;
         tripletNode["c"] >> table.triplet.c;
 
-        // Load Templates
-        cv::FileNode data = node["data"];
-        for (auto &&row : data) {
-            HashKey key;
-            cv::FileNode keyNode = row["key"];
-
-            keyNode["d1"] >> key.d1;
-            keyNode["d2"] >> key.d2;
-            keyNode["n1"] >> key.n1;
-            keyNode["n2"] >> key.n2;
-            keyNode["n3"] >> key.n3;
-
-            uint id = 0;
-            cv::FileNode templatesNode = row["templates"];
-
-            for (auto &&tplId : templatesNode) {
-                int tmp;
-                tplId >> tmp;
-                id = static_cast<uint>(tmp);
-
-                // Loop through existing templates and save pointers to matching ids
-                for (auto &t : templates) {
-                    if (id == t.id) {
-                        table.pushUnique(key, t);
-                    }
+        // Load postings of non-empty buckets (see operator<< for the format)
+        std::vector<int> keys, counts, ids;
+        node["keys"] >> keys;
+        node["counts"] >> counts;
+        node["ids"] >> ids;
+        if (keys.size() != counts.size()) {
+            return false;
+        }
+
+        long key = 0;
+        size_t p = 0;
+        table.size = 0;
+
+        for (size_t b = 0; b < keys.size(); ++b) {
+            key += keys[b];
+            if (key < 0 || key >= static_cast<long>(table.templates.size()) || counts[b] < 0 ||
+                static_cast<size_t>(counts[b]) > ids.size() - p) {
+                return false;
+            }
+
+            auto &bucket = table.templates[key];
+            bucket.reserve(static_cast<size_t>(counts[b]));
+            int id = 0;
+
+            for (int i = 0; i < counts[b]; ++i, ++p) {
+                id += ids[p];
+
+                // Resolve template pointer through id -> index map, postings of templates that are not loaded are skipped
+                auto found = indices.find(static_cast<uint>(id));
+                if (found != indices.end()) {
+                    bucket.push_back(&templates[found->second]);
+                    table.size++;
                 }
             }
         }
 
-        return table;
+        return true;
     }
 
     bool HashTable::operator<(const HashTable &rhs) const {
@@ -107,28 +123,31 @@ namespace tless {
         fs << "p2" << table.triplet.p2;
         fs << "}";
 
-        // Save Templates
-        fs << "data" << "[";
-        for (auto &tableRow : table.templates) {
-            // Save key
-            fs << "{";
-            fs << "key" << "{";
-            /*fs << "d1" << tableRow.first.d1;
-            fs << "d2" << tableRow.first.d2;
-            fs << "n1" << tableRow.first.n1;
-            fs << "n2" << tableRow.first.n2;
-            fs << "n3" << tableRow.first.n3;*/
-            fs << "}";
-
-            // Save template IDS
-            fs << "templates" << "[";
-            /*for (auto &t : tableRow.second) {
-                fs << static_cast<int>(t->id);
-            }*/
-            fs << "]";
-            fs << "}";
+        // Save postings of non-empty buckets only, as three flat arrays:
+        //  - keys: delta encoded indices of non-empty buckets
+        //  - counts: number of templates in each non-empty bucket
+        //  - ids: template ids of each bucket, delta encoded within the bucket
+        std::vector<int> keys, counts, ids;
+        int lastKey = 0;
+
+        for (size_t key = 0; key < table.templates.size(); ++key) {
+            const auto &bucket = table.templates[key];
+            if (bucket.empty()) continue;
+
+            keys.push_back(static_cast<int>(key) - lastKey);
+            counts.push_back(static_cast<int>(bucket.size()));
+            lastKey = static_cast<int>(key);
+            int lastId = 0;
+
+            for (const auto *t : bucket) {
+                ids.push_back(static_cast<int>(t->id) - lastId);
+                lastId = static_cast<int>(t->id);
+            }
         }
-        fs << "]";
+
+        fs << "keys" << keys;
+        fs << "counts" << counts;
+        fs << "ids" << ids;
         fs << "}";
 
         return fs;
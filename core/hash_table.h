@@ -27,15 +27,27 @@ namespace tless {
         HashTable() = default;
         HashTable(Triplet triplet) : triplet(triplet) {}
 
+        /**
+         * @brief Builds map of template ids to their index in templates array, used to resolve postings when loading tables.
+         *
+         * @param[in] templates Templates from dataset
+         * @return              Map of template id -> index in templates array
+         */
+        static std::unordered_map<uint, size_t> indexTemplates(const std::vector<Template> &templates);
+
         /**
          * @brief Loads hash table from trained classifier.yml file.
          *
-         * @param[in] node      File node identifying hash table in classifier.yml file
-         * @param[in] templates Templates from dataset, these are used to assign correct pointers for each hash key
-         *                      (comparison is done based on matching ids)
-         * @return              Parsed hash table, with all assigned template pointers
+         * Only non-empty buckets are stored, postings referencing templates that are not in templates array are skipped.
+         * Bucket keys and posting counts are validated, so corrupted file is rejected instead of read out of bounds.
+         *
+         * @param[in]  node      File node identifying hash table in classifier.yml file
+         * @param[in]  templates Templates from dataset, these are used to assign correct pointers for each hash key
+         * @param[in]  indices   Map of template ids to their index in templates array (see indexTemplates)
+         * @param[out] table     Parsed hash table, with all assigned template pointers
+         * @return               False if stored postings are corrupted
          */
-        static HashTable load(cv::FileNode &node, std::vector<Template> &templates);
+        static bool load(cv::FileNode &node, std::vector<Template> &templates, const std::unordered_map<uint, size_t> &indices, HashTable &table);
 
         /**
          * @brief Use when pushing new templates to hash table.
@@ -1,7 +1,7 @@
 #include "match.h"
 
 namespace tless {
-    cv::Rect Match::scaledBB(const cv::Rect &rect, float scale, float newScale) {
+    cv::Rect Match::scaledBB(const cv::Rect &rect, float scale, float newScale) const {
         float multiplier = newScale / scale;
 
         return cv::Rect(
@@ -12,7 +12,7 @@ namespace tless {
         );
     }
 
-    float Match::overlap(const Match &m) {
+    float Match::overlap(const Match &m) const {
         return (this->normObjBB & m.normObjBB).area() / static_cast<float>(std::min(this->normObjBB.area(), m.normObjBB.area()));
     }
 
@@ -31,7 +31,7 @@ namespace tless {
          * @param[in] newScale New scale we want to normalize bounding box into
          * @return             Scaled objBB to fit scene at wanted scale
          */
-        cv::Rect scaledBB(const cv::Rect &rect, float scale, float newScale = 1.0f);
+        cv::Rect scaledBB(const cv::Rect &rect, float scale, float newScale = 1.0f) const;
 
         /**
          * @brief Returns overlap [0-1] between two matches, normObjBB is used for overlap calculation
@@ -39,7 +39,7 @@ namespace tless {
          * @param[in] m Second match we want to perform overlap checking on
          * @return      Amount of overlap [0-1] between two matches
          */
-        float overlap(const Match &m);
+        float overlap(const Match &m) const;
 
         bool operator<(const Match &rhs) const;
         bool operator>(const Match &rhs) const;
@@ -1,6 +1,29 @@
+#include <initializer_list>
 #include "scene.h"
 
 namespace tless {
+    void ScenePyramid::reset(float scale, cv::MatAllocator *allocator) {
+        this->scale = scale;
+        srcRGB = cv::Mat();
+        srcGray = cv::Mat();
+        srcHue = cv::Mat();
+        srcDepth = cv::Mat();
+        srcGradients = cv::Mat();
+        srcNormals = cv::Mat();
+
+        // Allocator is used by create() of OpenCV functions writing into buffers, existing data is kept
+        for (cv::Mat *buffer : {&buffers.rgb, &buffers.resized, &buffers.depth, &buffers.gray, &buffers.hsv, &buffers.hue,
+                                &buffers.gradients, &buffers.normals, &buffers.rawNormals, &buffers.gradX, &buffers.gradY}) {
+            buffer->allocator = allocator;
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            buffers.bgr[i].allocator = allocator;
+            buffers.mags[i].allocator = allocator;
+            buffers.angles[i].allocator = allocator;
+        }
+    }
+
     std::ostream &operator<<(std::ostream &os, const Scene &scene) {
         os << "Scene id: " << scene.id
            << "Pyramid levels: " << scene.pyramid.size() << std::endl;
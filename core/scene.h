@@ -12,7 +12,43 @@ namespace tless {
         cv::Mat srcRGB, srcGray, srcHue, srcDepth; //!< Source scene in different
         cv::Mat srcGradients, srcNormals; //!< Matrix of quantized features
 
+        /**
+         * @brief Storage of the images above and of intermediate images used to compute them, kept between frames.
+         *
+         * Images of the level are views into these buffers, rebuilding the level for a frame of the same resolution
+         * rewrites them in place, so no image is allocated once the first frame was processed.
+         */
+        struct Buffers {
+            cv::Mat rgb, resized, depth; //!< Resampled RGB, resampled depth (values not rescaled) and filtered depth
+            cv::Mat gray, hsv, hue; //!< Color images
+            cv::Mat gradients, normals, rawNormals; //!< Quantized features (normals before median filter)
+            cv::Mat bgr[3], gradX, gradY, mags[3], angles[3]; //!< Intermediate images of quantized gradients
+        } buffers;
+
         ScenePyramid(float scale = 1.0f) : scale(scale) {}
+
+        /**
+         * @brief Drops images of the previous frame and sets new scale, buffers are kept to be reused.
+         *
+         * @param[in] scale     Scale of the level for the next frame
+         * @param[in] allocator Allocator used for buffers that have to be (re)allocated, nullptr for OpenCV default
+         */
+        void reset(float scale, cv::MatAllocator *allocator = nullptr);
+    };
+
+    /**
+     * @brief Single input frame of RGB-D sensor, used as input of detection.
+     */
+    struct Frame {
+    public:
+        uint id = 0;
+        cv::Mat rgb; //!< 8-bit 3 channel BGR image
+        cv::Mat depth; //!< 16-bit depth image registered to rgb image
+        cv::Mat K; //!< 3x3 float intrinsic camera matrix
+        cv::Mat R, t; //!< Optional camera rotation matrix and translation vector
+
+        Frame() = default;
+        Frame(const cv::Mat &rgb, const cv::Mat &depth, const cv::Mat &K, uint id = 0) : id(id), rgb(rgb), depth(depth), K(K) {}
     };
 
     /**
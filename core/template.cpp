@@ -1,6 +1,14 @@
 #include "template.h"
 
 namespace tless {
+    uint Template::objectId() const {
+        return objectId(id);
+    }
+
+    uint Template::objectId(uint id) {
+        return id / 2000;
+    }
+
     bool Template::operator==(const Template &rhs) const {
         return id == rhs.id;
     }
@@ -44,13 +44,25 @@ namespace tless {
         cv::Rect objBB; //!< Object bounding box
         Camera camera; //!< Camera parameters
         float objArea = 0; //!< Area object covers relative to it's window
-        int votes = 0;
         ushort minDepth = std::numeric_limits<unsigned short>::max(), maxDepth = 0; //!< Minimum and maximum depth of the object in this template
 
-        std::vector<Triplet> triplets; // TODO - remove/refactor, mostly for debugging, Triplets that were equal in hashing verification
-
         Template() = default;
 
+        /**
+         * @brief Returns id of the object this template belongs to (template ids are generated as index + 2000 * objectId).
+         *
+         * @return Object id
+         */
+        uint objectId() const;
+
+        /**
+         * @brief Returns id of the object template of given id belongs to, used where only template id is available.
+         *
+         * @param[in] id Template id
+         * @return       Object id
+         */
+        static uint objectId(uint id);
+
         bool operator==(const Template &rhs) const;
         bool operator!=(const Template &rhs) const;
         friend void operator>>(const cv::FileNode &node, Template &t);
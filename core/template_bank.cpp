@@ -0,0 +1,68 @@
+#include "template_bank.h"
+#include "../utils/thread_pool.h"
+
+namespace tless {
+    ScaledTemplate::ScaledTemplate(const Template &t, float scale) {
+        const float inv = 1.0f / scale;
+
+        objBB = cv::Rect(cvRound(t.objBB.x * inv), cvRound(t.objBB.y * inv), cvRound(t.objBB.width * inv), cvRound(t.objBB.height * inv));
+        diameter = t.diameter * scale;
+        depthMedian = cv::saturate_cast<ushort>(t.features.depthMedian * scale);
+
+        // Scale feature points
+        for (const auto &p : t.edgePoints) {
+            edgePoints.emplace_back(cvRound(p.x * inv), cvRound(p.y * inv));
+        }
+
+        for (const auto &p : t.stablePoints) {
+            stablePoints.emplace_back(cvRound(p.x * inv), cvRound(p.y * inv));
+        }
+
+        // Scale depths
+        for (const auto &d : t.features.depths) {
+            depths.push_back(cv::saturate_cast<ushort>(d * scale));
+        }
+    }
+
+    void TemplateBank::build(const std::vector<Template> &templates, const std::unordered_map<uint, size_t> &indices,
+                             const std::vector<float> &scales) {
+        assert(indices.size() == templates.size());
+        this->scales = scales;
+        this->indices = &indices;
+        levels.clear();
+        levels.resize(scales.size());
+
+        ThreadPool::global().parallelFor(0, static_cast<int>(scales.size()), [&](int l) {
+            levels[l].reserve(templates.size());
+
+            for (const auto &t : templates) {
+                levels[l].emplace_back(t, scales[l]);
+            }
+        });
+    }
+
+    const ScaledTemplate &TemplateBank::get(size_t level, const Template &t) const {
+        assert(level < levels.size());
+        assert(indices != nullptr);
+        return levels[level][indices->at(t.id)];
+    }
+
+    size_t TemplateBank::memory() const {
+        size_t bytes = 0;
+
+        for (const auto &level : levels) {
+            for (const auto &t : level) {
+                bytes += sizeof(ScaledTemplate);
+                bytes += t.edgePoints.capacity() * sizeof(cv::Point);
+                bytes += t.stablePoints.capacity() * sizeof(cv::Point);
+                bytes += t.depths.capacity() * sizeof(ushort);
+            }
+        }
+
+        return bytes;
+    }
+
+    bool TemplateBank::empty() const {
+        return levels.empty();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef VSB_SEMESTRAL_PROJECT_TEMPLATE_BANK_H
+#define VSB_SEMESTRAL_PROJECT_TEMPLATE_BANK_H
+
+#include <vector>
+#include <unordered_map>
+#include <opencv2/core/types.hpp>
+#include "template.h"
+
+namespace tless {
+    /**
+     * @brief Matching features of one template, scaled to be matched directly against full resolution scene.
+     *
+     * Scene at pyramid level of scale s has depth values divided by s and is s times larger, so instead of
+     * scaling the scene, feature points and bounding box are divided by s and depths are multiplied by s.
+     */
+    struct ScaledTemplate {
+    public:
+        cv::Rect objBB; //!< Scaled object bounding box
+        float diameter = 0; //!< Diameter scaled to be used with full resolution depths
+        ushort depthMedian = 0; //!< Scaled median value over all feature points
+        std::vector<cv::Point> edgePoints; //!< Scaled edge feature points
+        std::vector<cv::Point> stablePoints; //!< Scaled stable feature points
+        std::vector<ushort> depths; //!< Scaled depth values at stable feature points
+
+        ScaledTemplate() = default;
+        ScaledTemplate(const Template &t, float scale);
+    };
+
+    /**
+     * @brief Holds matching features of all templates pre-scaled for each scale of image pyramid.
+     *
+     * Built once when trained templates are loaded, used to match all scales against single full resolution scene
+     * instead of building scene image pyramid (criteria.preScaledTemplates).
+     */
+    class TemplateBank {
+    private:
+        const std::unordered_map<uint, size_t> *indices = nullptr; //!< Template id -> index into each level (owned by model)
+
+    public:
+        std::vector<float> scales; //!< Scale of each level (same as scales of image pyramid)
+        std::vector<std::vector<ScaledTemplate>> levels; //!< Scaled templates for each level
+
+        TemplateBank() = default;
+
+        /**
+         * @brief Generates scaled copies of matching features of all templates for given scales.
+         *
+         * @param[in] templates Loaded templates with trained features
+         * @param[in] indices   Map of template ids to their index in templates array, has to outlive the bank
+         * @param[in] scales    Scales of image pyramid to generate templates for
+         */
+        void build(const std::vector<Template> &templates, const std::unordered_map<uint, size_t> &indices,
+                   const std::vector<float> &scales);
+
+        /**
+         * @brief Returns scaled features of given template at given level.
+         *
+         * @param[in] level Index of the level (scale)
+         * @param[in] t     Template to get scaled features for
+         * @return          Scaled features of the template
+         */
+        const ScaledTemplate &get(size_t level, const Template &t) const;
+
+        /**
+         * @brief Computes memory occupied by all scaled templates.
+         *
+         * @return Approximate size of the bank in bytes
+         */
+        size_t memory() const;
+
+        bool empty() const;
+    };
+}
+
+#endif
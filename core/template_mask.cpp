@@ -0,0 +1,25 @@
+#include "template_mask.h"
+#include <algorithm>
+
+namespace tless {
+    TemplateMask::TemplateMask(const std::vector<Template> &templates, const std::vector<uint> &objectIds) {
+        if (objectIds.empty() || templates.empty()) {
+            return;
+        }
+
+        base = templates.data();
+        bits.resize(templates.size(), false);
+
+        for (size_t i = 0; i < templates.size(); ++i) {
+            bits[i] = std::find(objectIds.begin(), objectIds.end(), templates[i].objectId()) != objectIds.end();
+        }
+    }
+
+    bool TemplateMask::empty() const {
+        return bits.empty();
+    }
+
+    size_t TemplateMask::count() const {
+        return static_cast<size_t>(std::count(bits.begin(), bits.end(), true));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef VSB_SEMESTRAL_PROJECT_TEMPLATE_MASK_H
+#define VSB_SEMESTRAL_PROJECT_TEMPLATE_MASK_H
+
+#include <vector>
+#include "template.h"
+
+namespace tless {
+    /**
+     * @brief Bitmask over array of loaded templates, marking templates of objects that should be detected.
+     *
+     * Used in hashing verification to skip voting for templates of excluded objects, so these are never
+     * pushed as window candidates and never matched. Empty mask allows all templates.
+     */
+    class TemplateMask {
+    private:
+        const Template *base = nullptr; //!< First template of masked array, template index is computed from its address
+        std::vector<bool> bits;
+
+    public:
+        TemplateMask() = default;
+
+        /**
+         * @brief Creates mask allowing only templates of given objects.
+         *
+         * @param[in] templates Array of loaded templates, mask is valid only until this array is reallocated
+         * @param[in] objectIds Ids of objects to allow, empty to allow all templates
+         */
+        TemplateMask(const std::vector<Template> &templates, const std::vector<uint> &objectIds);
+
+        /**
+         * @brief Returns true if template from masked array is allowed by the mask.
+         *
+         * @param[in] t Pointer to template of masked array
+         * @return      True if template belongs to one of allowed objects or mask is empty
+         */
+        inline bool allowed(const Template *t) const {
+            return bits.empty() || bits[t - base];
+        }
+
+        /**
+         * @brief Returns true if mask allows all templates.
+         */
+        bool empty() const;
+
+        /**
+         * @brief Returns number of allowed templates (0 for empty mask).
+         */
+        size_t count() const;
+    };
+}
+
+#endif
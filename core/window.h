@@ -1,49 +1,140 @@
 #ifndef VSB_SEMESTRAL_PROJECT_WINDOW_H
 #define VSB_SEMESTRAL_PROJECT_WINDOW_H
 
+#include <vector>
+#include <algorithm>
 #include <opencv2/core/types.hpp>
 #include "template.h"
+#include "triplet.h"
+
+/**
+ * Triplets that voted for each candidate are recorded only for Visualizer::windowsCandidates. Recording costs
+ * a push for every vote, so it's compiled only into debug builds, or into any build configured with TRACE_VOTES.
+ */
+#if !defined(NDEBUG) && !defined(TLESS_TRACE_VOTES)
+#define TLESS_TRACE_VOTES
+#endif
 
 namespace tless {
+    /**
+     * @brief Flat candidate record of a window, template is referenced by its index in the pinned model.
+     */
+    struct Candidate {
+        uint index; //!< Index of the template in templates array of the model
+        int votes; //!< Number of votes of the template in hashing verification
+
+        Candidate() = default;
+        Candidate(uint index, int votes) : index(index), votes(votes) {}
+    };
+
+    /**
+     * @brief Pushes only unique templates with minimum of votes building array of size up to N.
+     *
+     * If template already is a candidate, only its number of votes is updated, when array is full template
+     * with least votes is replaced.
+     *
+     * @param[in,out] candidates Candidates of a window
+     * @param[in]     index      Index of the template in templates array of the model
+     * @param[in]     votes      Number of votes of the template
+     * @param[in]     N          Max number of candidates
+     * @param[in]     minVotes   Templates with less votes are ignored
+     */
+    inline void pushUnique(std::vector<Candidate> &candidates, uint index, int votes, size_t N, int minVotes) {
+        if (votes < minVotes) return;
+
+        // Check for duplicates, update votes of existing candidate
+        for (auto &candidate : candidates) {
+            if (candidate.index == index) {
+                candidate.votes = votes;
+                return;
+            }
+        }
+
+        // Replace template with least amount of votes if candidate array is full
+        if (candidates.size() >= N) {
+            auto min = std::min_element(candidates.begin(), candidates.end(), [](const Candidate &c1, const Candidate &c2) {
+                return c1.votes < c2.votes;
+            });
+
+            *min = Candidate(index, votes);
+        } else {
+            candidates.emplace_back(index, votes);
+        }
+    }
+
+#ifdef TLESS_TRACE_VOTES
+    /**
+     * @brief Triplets that voted for a candidate (allocated in frame arena).
+     */
+    struct CandidateTriplets {
+        const Triplet *triplets;
+        int count;
+    };
+#endif
+
     /**
      * @brief Contains location of windows that passed objectness detection.
+     *
+     * Candidate arrays are allocated in frame arena of the processed level, so window is trivially destructible
+     * and clearing windows of a level never touches the heap.
      */
     class Window {
     public:
         int x = 0, y = 0;
         int width = 0, height = 0;
         int edgels = 0; //!< Number of edgels this window contain (detected in objectness detection)
-        std::vector<Template *> candidates;
-        std::vector<int> votes; // TODO better handle saving of candidate votes
-        std::vector<std::vector<Triplet>> triplets; // TODO better handle saving of candidate triplets
+        float scale = 1.0f; //!< Scale of the scene in this window relative to templates (only in depth scaled detection)
+        ushort depth = 0; //!< Scene depth in the center of this window (only in depth scaled detection)
+        Candidate *candidates = nullptr; //!< Candidates sorted by votes (allocated in frame arena)
+        int candidatesCount = 0;
+#ifdef TLESS_TRACE_VOTES
+        CandidateTriplets *triplets = nullptr; //!< Triplets that voted for each candidate (parallel to candidates)
+#endif
 
         Window() = default;
         Window(int x, int y, int width, int height, int edgels)
                 : x(x), y(y), width(width), height(height), edgels(edgels) {}
+        Window(int x, int y, int width, int height, int edgels, float scale, ushort depth)
+                : x(x), y(y), width(width), height(height), edgels(edgels), scale(scale), depth(depth) {}
         Window(cv::Rect rect, int edgels)
                 : x(rect.tl().x), y(rect.tl().y), width(rect.width), height(rect.height), edgels(edgels) {}
 
-        cv::Point tl();
-        cv::Point tr();
-        cv::Point bl();
-        cv::Point br();
-        cv::Rect rect();
+        cv::Point tl() const;
+        cv::Point tr() const;
+        cv::Point bl() const;
+        cv::Point br() const;
+        cv::Rect rect() const;
 
         /**
          * @brief Returns true whether there are any templates (candidates) in candidates array.
          *
          * @return True if candidates array is not empty
          */
-        bool hasCandidates();
+        bool hasCandidates() const;
 
         /**
-         * @brief Used in hashing verification, to push only new unique candidates to candidates array.
+         * @brief Removes candidates not satisfying the predicate, keeping order of remaining candidates.
          *
-         * @param[in] t        Template to push to candidates array
-         * @param[in] N        Maximum number of templates the candidate array can hold (it will always hold top N candidates)
-         * @param[in] minVotes Minimum number of votes template has to have to be used as candidate
+         * @param[in] keep Predicate called with each candidate, returns false for candidates to remove
          */
-        void pushUnique(Template *t, int N = 100, int minVotes = 3);
+        template<typename Predicate>
+        void filterCandidates(Predicate keep) {
+            int count = 0;
+
+            for (int i = 0; i < candidatesCount; ++i) {
+                if (!keep(candidates[i])) continue;
+
+                candidates[count] = candidates[i];
+#ifdef TLESS_TRACE_VOTES
+                if (triplets != nullptr) {
+                    triplets[count] = triplets[i];
+                }
+#endif
+                ++count;
+            }
+
+            candidatesCount = count;
+        }
 
         bool operator<(const Window &rhs) const;
         bool operator>(const Window &rhs) const;
@@ -31,6 +31,7 @@ int main() {
 
     // Kinect
 //    classifier.train("data/templates_kinectv2.txt", "data/trained/kinectv2/");
+//    classifier.convert("data/trained_kinectv2.txt", "data/trained/kinectv2/");
     classifier.detect("data/trained_kinectv2.txt", "data/trained/kinectv2/", "data/scenes/kinectv2/02/");
 
     return 0;
@@ -0,0 +1,140 @@
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <iomanip>
+#include "cascade_stats.h"
+
+namespace tless {
+    // Thread-local instances of all threads that ever matched, owned here so they outlive their threads
+    static std::mutex registryMutex;
+    static std::vector<std::shared_ptr<CascadeStats>> registry;
+
+    static const char *TEST_NAMES[CascadeStats::TESTS] = {"I", "II", "III", "IV", "V"};
+
+    void CascadeStats::Test::merge(const Test &other) {
+        entered += other.entered;
+        rejected += other.rejected;
+        points += other.points;
+        matched += other.matched;
+        time += other.time;
+    }
+
+    int64_t CascadeStats::Tests::record(int test, float matched, uint points, bool passed, int64_t begin) {
+        const int64_t end = now();
+        Test &t = tests[test];
+
+        t.entered++;
+        t.rejected += passed ? 0 : 1;
+        t.points += points;
+        t.matched += static_cast<uint64_t>(matched);
+        t.time += end - begin;
+
+        return end;
+    }
+
+    CascadeStats::Tests &CascadeStats::at(int level, uint objectId) {
+        return stats[std::make_pair(level, objectId)];
+    }
+
+    void CascadeStats::merge(const CascadeStats &other) {
+        for (auto &entry : other.stats) {
+            Tests &tests = stats[entry.first];
+            for (int i = 0; i < TESTS; ++i) {
+                tests.tests[i].merge(entry.second.tests[i]);
+            }
+        }
+    }
+
+    void CascadeStats::clear() {
+        stats.clear();
+    }
+
+    bool CascadeStats::empty() const {
+        return stats.empty();
+    }
+
+    CascadeStats &CascadeStats::local() {
+        static thread_local CascadeStats *instance = nullptr;
+
+        if (instance == nullptr) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry.emplace_back(new CascadeStats());
+            instance = registry.back().get();
+        }
+
+        return *instance;
+    }
+
+    void CascadeStats::collect(CascadeStats &result) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+
+        for (auto &instance : registry) {
+            result.merge(*instance);
+            instance->clear();
+        }
+    }
+
+    int64_t CascadeStats::now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void CascadeStats::printRow(std::ostream &os, const std::string &label, const Tests &tests) const {
+        os << "  |_ " << label << std::endl;
+
+        for (int i = 0; i < TESTS; ++i) {
+            const Test &t = tests.tests[i];
+            if (t.entered == 0) continue;
+
+            os << "    |_ test " << std::setw(3) << std::left << TEST_NAMES[i] << std::right
+               << " entered: " << std::setw(9) << t.entered
+               << ", rejected: " << std::setw(9) << t.rejected
+               << " (" << std::fixed << std::setprecision(1) << std::setw(5) << 100.0 * t.rejected / t.entered << "%)"
+               << ", points: " << std::setprecision(1) << static_cast<double>(t.points) / t.entered
+               << ", matched: " << std::setprecision(1) << static_cast<double>(t.matched) / t.entered
+               << ", took: " << std::setprecision(3) << t.time * 1e-9 << "s" << std::endl;
+        }
+    }
+
+    void CascadeStats::print(std::ostream &os) const {
+        const std::ios::fmtflags flags = os.flags();
+        const std::streamsize precision = os.precision();
+        Tests total;
+        std::map<int, Tests> levels;
+        std::map<uint, Tests> objects;
+
+        for (auto &entry : stats) {
+            for (int i = 0; i < TESTS; ++i) {
+                total.tests[i].merge(entry.second.tests[i]);
+                levels[entry.first.first].tests[i].merge(entry.second.tests[i]);
+                objects[entry.first.second].tests[i].merge(entry.second.tests[i]);
+            }
+        }
+
+        os << "Matching cascade (points and matched are averages per entered candidate):" << std::endl;
+        printRow(os, "all", total);
+
+        for (auto &level : levels) {
+            printRow(os, "level " + std::to_string(level.first), level.second);
+        }
+
+        for (auto &object : objects) {
+            printRow(os, "object " + std::to_string(object.first), object.second);
+        }
+
+        os.flags(flags);
+        os.precision(precision);
+    }
+
+    void CascadeStats::writeCSV(std::ostream &os) const {
+        os << "level,object,test,entered,rejected,points,matched,time_ns" << std::endl;
+
+        for (auto &entry : stats) {
+            for (int i = 0; i < TESTS; ++i) {
+                const Test &t = entry.second.tests[i];
+                os << entry.first.first << "," << entry.first.second << "," << TEST_NAMES[i] << "," << t.entered << ","
+                   << t.rejected << "," << t.points << "," << t.matched << "," << t.time << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef VSB_SEMESTRAL_PROJECT_CASCADE_STATS_H
+#define VSB_SEMESTRAL_PROJECT_CASCADE_STATS_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <ostream>
+#include <cstdint>
+#include <opencv2/core/hal/interface.h>
+
+namespace tless {
+    /**
+     * @brief Statistics of template matching cascade (tests I-V), broken down by pyramid level and object id.
+     *
+     * Matcher records into thread-local instance of the calling thread (see local()), so recording never
+     * synchronizes. Thread-local instances are merged by collect(), once no matching is running.
+     */
+    class CascadeStats {
+    public:
+        static const int TESTS = 5;
+
+        struct Test {
+            uint64_t entered = 0; //!< Candidates that entered the test
+            uint64_t rejected = 0; //!< Candidates rejected by the test
+            uint64_t points = 0; //!< Feature points evaluated
+            uint64_t matched = 0; //!< Feature points matched
+            int64_t time = 0; //!< Time spent in the test (in nanoseconds)
+
+            void merge(const Test &other);
+        };
+
+        struct Tests {
+            Test tests[TESTS];
+
+            /**
+             * @brief Records one candidate evaluated by given test.
+             *
+             * @param[in] test    Index of the test (0 for test I)
+             * @param[in] matched Number of matched feature points
+             * @param[in] points  Number of evaluated feature points
+             * @param[in] passed  Whether candidate passed the test
+             * @param[in] begin   Time the test started at (see now())
+             * @return            Current time, used as beginning of the next test
+             */
+            int64_t record(int test, float matched, uint points, bool passed, int64_t begin);
+        };
+
+    private:
+        std::map<std::pair<int, uint>, Tests> stats; //!< Keyed by (pyramid level, object id)
+
+        void printRow(std::ostream &os, const std::string &label, const Tests &tests) const;
+
+    public:
+        /**
+         * @brief Returns statistics of given pyramid level and object, created if they don't exist.
+         */
+        Tests &at(int level, uint objectId);
+
+        void merge(const CascadeStats &other);
+        void clear();
+        bool empty() const;
+
+        /**
+         * @brief Returns instance owned by the calling thread.
+         */
+        static CascadeStats &local();
+
+        /**
+         * @brief Merges thread-local instances of all threads into result and clears them.
+         *
+         * Must not run concurrently with matching, thread pool makes results of finished tasks visible.
+         */
+        static void collect(CascadeStats &result);
+
+        /**
+         * @brief Returns monotonic time in nanoseconds.
+         */
+        static int64_t now();
+
+        /**
+         * @brief Prints totals of each test, followed by breakdowns per pyramid level and per object id.
+         */
+        void print(std::ostream &os) const;
+
+        /**
+         * @brief Writes one CSV row per level, object and test.
+         */
+        void writeCSV(std::ostream &os) const;
+    };
+}
+
+#endif
@@ -1,11 +1,27 @@
 #include "classifier.h"
+#include <algorithm>
+#include <future>
+#include <fstream>
 #include <boost/filesystem.hpp>
 #include "../utils/timer.h"
 #include "../utils/visualizer.h"
 #include "../core/classifier_criteria.h"
 #include "../processing/processing.h"
+#include "../processing/computation.h"
+#include "../utils/model_file.h"
+#include "frame_prefetcher.h"
+#include "../utils/task_graph.h"
+#include "../utils/thread_pool.h"
+#include "../utils/tracer.h"
+#include "cascade_stats.h"
 
 namespace tless {
+    Classifier::Classifier(cv::Ptr<ClassifierCriteria> criteria) : criteria(criteria) {
+        if (!ThreadPool::configureGlobal(static_cast<size_t>(std::max(criteria->threads, 0)), criteria->pinThreads)) {
+            std::cout << "  |_ thread pool already running with " << ThreadPool::global().size() << " threads, criteria threads ignored" << std::endl;
+        }
+    }
+
     void Classifier::train(std::string templatesListPath, std::string resultPath, std::vector<uint> indices) {
         std::ifstream ifs(templatesListPath);
         assert(ifs.is_open());
@@ -18,6 +34,7 @@ namespace tless {
         // Init common
         std::ostringstream oss;
         std::vector<Template> templates, allTemplates;
+        std::vector<HashTable> tables;
         std::string path;
 
         // Create directories if doesnt exist
@@ -77,130 +94,459 @@ namespace tless {
         }
         fsw << "]";
         fsw.release();
-
         std::cout << "  |_ tables -> " << resultPath + "classifier.yml.gz" << std::endl;
+
+        // Persist binary model
+        if (ModelFile::write(resultPath + "classifier.bin", *criteria, allTemplates, HashTable::indexTemplates(allTemplates), tables)) {
+            std::cout << "  |_ model -> " << resultPath + "classifier.bin" << std::endl;
+        } else {
+            std::cout << "  |_ failed to write model -> " << resultPath + "classifier.bin" << std::endl;
+        }
         std::cout << "DONE!, took: " << tTraining.elapsed() << " s" << std::endl << std::endl;
     }
 
-    void Classifier::load(const std::string &trainedTemplatesListPath, const std::string &trainedPath) {
-        std::ifstream ifs(trainedTemplatesListPath);
-        assert(ifs.is_open());
+    std::shared_ptr<Model> Classifier::snapshot() const {
+        return std::atomic_load(&model);
+    }
 
-        Timer tLoading;
-        std::string path;
-        std::cout << "Loading trained templates... " << std::endl;
+    bool Classifier::load(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds) {
+        // Build new model aside and publish it only when it's complete, frames in progress keep their snapshot
+        auto next = std::make_shared<Model>(*criteria);
+        if (!next->load(trainedTemplatesListPath, trainedPath, objectIds)) {
+            return false;
+        }
 
-        while (ifs >> path) {
-            std::cout << "  |_ " << path;
+        std::atomic_store(&model, next);
+        return true;
+    }
+
+    std::future<bool> Classifier::reload(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds) {
+        return std::async(std::launch::async, [this, trainedTemplatesListPath, trainedPath, objectIds]() {
+            return load(trainedTemplatesListPath, trainedPath, objectIds);
+        });
+    }
 
-            // Load trained data
-            cv::FileStorage fsr(path, cv::FileStorage::READ);
-            cv::FileNode tpls = fsr["templates"];
+    bool Classifier::loadObjects(const std::vector<uint> &objectIds) {
+        auto current = snapshot();
+        assert(current);
 
-            // Loop through templates
-            for (auto &&t : tpls) {
-                Template nTpl;
-                t >> nTpl;
-                templates.push_back(nTpl);
+        // All objects are already loaded
+        if (current->objectIds.empty()) {
+            return true;
+        }
+
+        if (objectIds.empty()) {
+            return load(current->listPath, current->path, {});
+        }
+
+        std::vector<uint> added;
+        for (uint id : objectIds) {
+            if (std::find(current->objectIds.begin(), current->objectIds.end(), id) == current->objectIds.end() &&
+                std::find(added.begin(), added.end(), id) == added.end()) {
+                added.push_back(id);
             }
+        }
+
+        if (added.empty()) {
+            return true;
+        }
 
-            fsr.release();
-            std::cout << " -> LOADED" << std::endl;
+        // Current model is still in use, new model reuses its templates and loads only added objects
+        auto next = std::make_shared<Model>(*criteria);
+        if (!next->extend(*current, added)) {
+            return false;
         }
 
-        // Load data set
-        cv::FileStorage fsr(trainedPath + "classifier.yml.gz", cv::FileStorage::READ);
-        fsr["criteria"] >> criteria;
-        std::cout << "  |_ info -> LOADED" << std::endl;
-        std::cout << "  |_ loading hashtables..." << std::endl;
+        std::atomic_store(&model, next);
+        return true;
+    }
+
+    void Classifier::convert(const std::string &trainedTemplatesListPath, const std::string &trainedPath) {
+        Timer tConverting;
+        std::cout << "Converting trained templates... " << std::endl;
+
+        Model yml(*criteria);
+        if (!yml.loadYml(trainedTemplatesListPath, trainedPath, {})) {
+            std::cout << "FAILED!, took: " << tConverting.elapsed() << " s" << std::endl << std::endl;
+            return;
+        }
 
-        // Load hash tables
-        cv::FileNode hashTables = fsr["tables"];
-        for (auto &&table : hashTables) {
-            tables.emplace_back(HashTable::load(table, templates));
+        if (!ModelFile::write(trainedPath + "classifier.bin", *yml.criteria, yml.templates, yml.indices, yml.tables)) {
+            std::cout << "  |_ failed to write model -> " << trainedPath + "classifier.bin" << std::endl;
+            std::cout << "FAILED!, took: " << tConverting.elapsed() << " s" << std::endl << std::endl;
+            return;
         }
 
-        fsr.release();
-        std::cout << "  |_ hashTables -> LOADED (" << tables.size() << ")" << std::endl;
-        std::cout << "DONE!, took: " << tLoading.elapsed() << " s" << std::endl << std::endl;
+        std::cout << "  |_ model -> " << trainedPath + "classifier.bin" << std::endl;
+        std::cout << "DONE!, took: " << tConverting.elapsed() << " s" << std::endl << std::endl;
     }
 
-    void Classifier::detect(std::string trainedTemplatesListPath, std::string trainedPath, std::string scenePath) {
-        // Checks
-        assert(criteria->info.smallestTemplate.area() > 0);
-        assert(criteria->info.minEdgels > 0);
+    void Classifier::detectScene(DetectionContext &ctx) const {
+        TraceSpan span("detectScene");
+        const std::shared_ptr<Model> &m = ctx.model;
+        cv::Ptr<ClassifierCriteria> crit = m->criteria;
+        assert(crit->info.smallestTemplate.area() > 0);
+        assert(crit->info.minEdgels > 0);
+
+        // Init classifiers with criteria of pinned model
+        Parser parser(crit);
+        Objectness objectness(crit);
+        Hasher hasher(crit);
+        Matcher matcher(crit);
+
+        // Image pyramid, pre-scaled templates and depth scaled detection work on full resolution scene only
+        const bool fullResolution = crit->preScaledTemplates || crit->depthScaledWindows;
+        const int pyrLevels = crit->preScaledTemplates ? static_cast<int>(m->bank.scales.size()) - 1 :
+                              (fullResolution ? 0 : crit->pyrLvlsDown + crit->pyrLvlsUp);
+
+        // Coarse-to-fine search restricts finer levels by seeds found on coarse levels
+        const int coarseLevels = crit->coarseToFine ? std::min(crit->coarseLevels, pyrLevels + 1) : pyrLevels + 1;
+        ctx.prepare(static_cast<size_t>(pyrLevels + 1));
+
+        // All scales of pre-scaled templates are matched against full resolution scene, its features are computed
+        // upfront for the whole scene (see windowsROI), so that concurrently processed levels never compute them
+        if (crit->preScaledTemplates && !ctx.scene.pyramid[0].srcDepth.empty()) {
+            parser.computeNormals(ctx.scene.pyramid[0]);
+            parser.computeGradients(ctx.scene.pyramid[0]);
+            parser.computeColors(ctx.scene.pyramid[0]);
+        }
 
-        // Init classifiers
-        Parser parser(criteria);
-        Objectness objectness(criteria);
-        Hasher hasher(criteria);
-        Matcher matcher(criteria);
+        // Candidates of each window are recorded directly from verification tasks (histograms are lock-free)
+        Histogram *windowCandidates = ctx.metrics ? &ctx.metrics->counter("window.candidates") : nullptr;
+
+        // Each level is a chain of objectness -> verification -> matching tasks, chains of different levels overlap
+        TaskGraph graph;
+        std::vector<size_t> coarseMatching;
+        size_t seeding = 0;
+        bool seeded = false;
+
+        for (int l = 0; l <= pyrLevels; ++l) {
+            ScenePyramid &level = ctx.scene.pyramid[crit->preScaledTemplates ? 0 : l];
+            DetectionContext::Level &state = ctx.levels[l];
+
+            // Skip levels pruned in scene parsing
+            if (level.srcDepth.empty()) {
+                continue;
+            }
+
+            // Seeds of all coarse levels are merged before first finer level starts
+            const bool coarse = l < coarseLevels;
+            if (!coarse && !seeded) {
+                // Without any coarse level processed there are no seeds to search finer levels around
+                if (coarseMatching.empty()) {
+                    break;
+                }
+
+                seeding = graph.add([&ctx, coarseLevels] {
+                    TraceSpan span("seeding");
+                    for (int c = 0; c < coarseLevels; ++c) {
+                        ctx.seeds.insert(ctx.seeds.end(), ctx.levels[c].seeds.begin(), ctx.levels[c].seeds.end());
+                    }
+                }, coarseMatching);
+                seeded = true;
+            }
+
+            // Objectness detection
+            const size_t tObjectness = graph.add([&, l, coarse] {
+                TraceSpan span("objectness", l);
+                Timer tObjectness;
+                if (!coarse && ctx.seeds.empty()) {
+                    return;
+                }
+
+                if (crit->preScaledTemplates) {
+                    objectness.objectness(level.srcDepth, state.windows, state.edgels, state.integral, m->bank.scales[l]);
+                } else if (crit->depthScaledWindows) {
+                    objectness.objectnessScaled(level.srcDepth, state.windows, state.edgels, state.integral);
+                } else {
+                    objectness.objectness(level.srcDepth, state.windows, state.edgels, state.integral);
+                }
+                if (!coarse) {
+                    ctx.filterWindows(state.windows, level.scale);
+                }
+                state.counts.windows = state.windows.size();
+                state.timings.objectness = tObjectness.elapsed();
+            }, coarse ? std::vector<size_t>() : std::vector<size_t>{seeding});
+
+            /// Verification and filtering of template candidates
+            const size_t tVerification = graph.add([&, l, coarse] {
+                if (state.windows.empty()) {
+                    return;
+                }
+
+                TraceSpan span("verification", l);
+
+                Timer tVerification;
+                parser.computeNormals(level, ctx.windowsROI(state.windows));
+                hasher.verifyCandidates(level.srcDepth, level.srcNormals, state, ctx);
+                if (!coarse) {
+                    ctx.filterCandidates(state.windows, level.scale);
+                }
+                state.timings.verification = tVerification.elapsed();
+
+                for (auto &window : state.windows) {
+                    state.counts.candidates += window.candidatesCount;
+                    if (windowCandidates) {
+                        windowCandidates->record(window.candidatesCount);
+                    }
+                }
+            }, {tObjectness});
+
+            /// Match templates
+            const size_t tMatching = graph.add([&, l] {
+                if (state.windows.empty()) {
+                    return;
+                }
+
+                TraceSpan span("matching", l);
+
+                Timer tMatching;
+                cv::Rect roi = ctx.windowsROI(state.windows);
+                parser.computeGradients(level, roi);
+                parser.computeColors(level, roi);
+
+                matcher.match(level, m->templates, state.windows, state.matches, crit->preScaledTemplates ? &m->bank : nullptr, static_cast<size_t>(l),
+                              crit->coarseToFine ? &state.seeds : nullptr);
+                state.windows.clear();
+                state.timings.matching = tMatching.elapsed();
+            }, {tVerification});
+
+            if (coarse) {
+                coarseMatching.push_back(tMatching);
+            }
+        }
+
+        graph.run();
+
+        // Collect matches and stage timings of all levels
+        for (auto &state : ctx.levels) {
+            ctx.matches.insert(ctx.matches.end(), state.matches.begin(), state.matches.end());
+            ctx.timings.objectness += state.timings.objectness;
+            ctx.timings.verification += state.timings.verification;
+            ctx.timings.matching += state.timings.matching;
+        }
+
+        const size_t matchesBeforeNMS = ctx.matches.size();
+
+        // Apply non-maxima suppression
+        Timer tNMS;
+        nms(ctx.matches, crit->overlapFactor);
+        ctx.timings.nms = tNMS.elapsed();
+
+        if (ctx.metrics) {
+            recordMetrics(ctx, matchesBeforeNMS);
+        }
+    }
+
+    void Classifier::recordMetrics(const DetectionContext &ctx, size_t matchesBeforeNMS) const {
+        Metrics &metrics = *ctx.metrics;
+        DetectionContext::Counts counts;
+
+        // Levels that were not processed (pruned or without seeds) never ran objectness and are not recorded
+        for (size_t l = 0; l < ctx.levels.size(); ++l) {
+            const DetectionContext::Level &state = ctx.levels[l];
+            counts.windows += state.counts.windows;
+            counts.candidates += state.counts.candidates;
+            if (state.timings.objectness == 0) continue;
+
+            const std::string prefix = "level." + std::to_string(l) + ".";
+            metrics.recordSeconds(prefix + "objectness", state.timings.objectness);
+            metrics.recordSeconds(prefix + "verification", state.timings.verification);
+            metrics.recordSeconds(prefix + "matching", state.timings.matching);
+            metrics.recordCount(prefix + "windows", state.counts.windows);
+            metrics.recordCount(prefix + "candidates", state.counts.candidates);
+        }
+
+        metrics.recordSeconds("frame.objectness", ctx.timings.objectness);
+        metrics.recordSeconds("frame.verification", ctx.timings.verification);
+        metrics.recordSeconds("frame.matching", ctx.timings.matching);
+        metrics.recordSeconds("frame.nms", ctx.timings.nms);
+        metrics.recordCount("frame.windows", counts.windows);
+        metrics.recordCount("frame.candidates", counts.candidates);
+        metrics.recordCount("frame.matchesBeforeNMS", matchesBeforeNMS);
+        metrics.recordCount("frame.matchesAfterNMS", ctx.matches.size());
+    }
+
+    void Classifier::createScene(const Model &model, const Frame &frame, Scene &scene) const {
+        TraceSpan span("createScene");
+        cv::Ptr<ClassifierCriteria> crit = model.criteria;
+        const bool fullResolution = crit->preScaledTemplates || crit->depthScaledWindows;
+        Parser parser(crit);
+
+        parser.createScene(frame, crit->pyrScaleFactor, fullResolution ? 0 : crit->pyrLvlsDown, fullResolution ? 0 : crit->pyrLvlsUp, scene);
+    }
+
+    const std::vector<Match> &Classifier::detect(DetectionContext &ctx, const Frame &frame) const {
+        Timer tSceneLoading;
+
+        // Pin current model for the whole frame, model can be replaced by reload() in the meantime
+        ctx.pin(snapshot());
+        assert(ctx.model);
+
+        // Rebuild scene pyramid of previous frame in place
+        createScene(*ctx.model, frame, ctx.scene);
+        ctx.timings.sceneLoading = tSceneLoading.elapsed();
+        if (ctx.metrics) {
+            ctx.metrics->recordSeconds("frame.sceneLoading", ctx.timings.sceneLoading);
+        }
+
+        detectScene(ctx);
+        return ctx.matches;
+    }
+
+    const std::vector<Match> &Classifier::detect(DetectionContext &ctx, const cv::Mat &rgb, const cv::Mat &depth, const cv::Mat &K) const {
+        return detect(ctx, Frame(rgb, depth, K));
+    }
+
+    void Classifier::detect(FrameSource &source, std::vector<uint> filterIds) {
+        // Visualization uses detect params only, which are the same in all models
         Visualizer viz(criteria);
-        Scene scene;
+        const bool fullResolution = criteria->preScaledTemplates || criteria->depthScaledWindows;
+        const int pyrLvlsDown = fullResolution ? 0 : criteria->pyrLvlsDown;
+
+        // All per-frame state lives in context, which is reused for all frames
+        DetectionContext ctx;
+        ctx.filter(filterIds);
+        Frame frame;
+
+        // Timeline of the whole run, written at the end
+        Tracer &tracer = Tracer::global();
+        if (!criteria->tracePath.empty()) {
+            tracer.nameThread("main");
+            tracer.enable();
+        }
 
-        // Load trained template data
-        load(trainedTemplatesListPath, trainedPath);
+        // Metrics of the whole run, dumped at the end or whenever SIGUSR1 is received
+        Metrics metrics;
+        if (!criteria->metricsPath.empty()) {
+            ctx.metrics = &metrics;
+            Metrics::dumpOnSignal();
+        }
 
-        // Image pyramid
-        const int pyrLevels = criteria->pyrLvlsDown + criteria->pyrLvlsUp;
+        // Load and preprocess next frames in background while current frame is being matched
+        std::unique_ptr<FramePrefetcher> prefetcher;
+        FramePrefetcher::Item prefetched;
+        if (criteria->prefetchFrames > 0) {
+            prefetcher.reset(new FramePrefetcher(source, static_cast<size_t>(criteria->prefetchFrames), [this](FramePrefetcher::Item &item) {
+                item.model = snapshot();
+                assert(item.model);
+                createScene(*item.model, item.frame, item.scene);
+            }));
+        }
 
         // Timing
         Timer tTotal;
-        double ttSceneLoading, ttObjectness, ttVerification, ttMatching, ttNMS;
         std::cout << "Matching started..." << std::endl << std::endl;
 
-        for (int i = 0; i < 503; ++i) {
-            // Reset timers
-            ttObjectness = ttVerification = ttMatching = 0;
+        while (true) {
+            // Load frame
             tTotal.reset();
+            Timer tFrameLoading;
+            double ttFrameLoading;
+
+            if (prefetcher) {
+                bool next;
+                {
+                    TraceSpan span("waitFrame");
+                    next = prefetcher->next(prefetched);
+                }
 
-            // Load scene
-            Timer tSceneLoading;
-            scene = parser.parseScene(scenePath, i, criteria->pyrScaleFactor, criteria->pyrLvlsDown, criteria->pyrLvlsUp);
-            ttSceneLoading = tSceneLoading.elapsed();
+                if (!next) {
+                    break;
+                }
 
-            // Verification for a pyramid
-            for (int l = 0; l <= pyrLevels; ++l) {
-                // Objectness detection
-                Timer tObjectness;
-                objectness.objectness(scene.pyramid[l].srcDepth, windows);
-                ttObjectness += tObjectness.elapsed();
-//                viz.objectness(scene.pyramid[l], windows);
+                // Scene was built for prefetched model, detect with the same model even if it was replaced meanwhile
+                ttFrameLoading = tFrameLoading.elapsed();
+                ctx.pin(prefetched.model);
+                std::swap(ctx.scene, prefetched.scene);
 
-                /// Verification and filtering of template candidates
-                if (windows.empty()) {
-                    continue;
+                // Scene of previous frame is handed back, so its buffers are reused for one of the next frames
+                prefetcher->recycle(std::move(prefetched.scene));
+                if (ctx.metrics) {
+                    ctx.metrics->recordSeconds("frame.sceneLoading", prefetched.loading);
+                }
+                detectScene(ctx);
+            } else {
+                if (!source.next(frame)) {
+                    break;
                 }
 
-                Timer tVerification;
-                hasher.verifyCandidates(scene.pyramid[l].srcDepth, scene.pyramid[l].srcNormals, tables, windows);
-                ttVerification += tVerification.elapsed();
-//                viz.windowsCandidates(scene.pyramid[l], windows);
-
-                /// Match templates
-                Timer tMatching;
-                matcher.match(scene.pyramid[l], windows, matches);
-                ttMatching += tMatching.elapsed();
-                windows.clear();
+                ttFrameLoading = tFrameLoading.elapsed();
+                detect(ctx, frame);
             }
 
-            // Apply non-maxima suppression
-//            viz.preNonMaxima(scene.pyramid[criteria->pyrLvlsDown], matches);
-            Timer tNMS;
-            nms(matches, criteria->overlapFactor);
-            ttNMS = tNMS.elapsed();
+            const double ttTotal = tTotal.elapsed();
+            if (ctx.metrics) {
+                metrics.recordSeconds("frame.loading", ttFrameLoading);
+                metrics.recordSeconds("frame.total", ttTotal);
+                if (Metrics::dumpRequested()) {
+                    dumpMetrics(metrics);
+                }
+            }
 
             // Print results
-            std::cout << std::endl << "Classification took: " << tTotal.elapsed() << "s" << std::endl;
-            std::cout << "  |_ Scene loading took: " << ttSceneLoading << "s" << std::endl;
-            std::cout << "  |_ Objectness detection took: " << ttObjectness << "s" << std::endl;
-            std::cout << "  |_ Hashing verification took: " << ttVerification << "s" << std::endl;
-            std::cout << "  |_ Template matching took: " << ttMatching << "s" << std::endl;
-            std::cout << "  |_ NMS took: " << ttNMS << "s" << std::endl;
+            std::cout << std::endl << "Classification took: " << ttTotal << "s" << std::endl;
+            std::cout << "  |_ Scene loading took: " << ttFrameLoading + ctx.timings.sceneLoading << "s" << std::endl;
+            if (prefetcher) {
+                std::cout << "    |_ Prefetched in background in: " << prefetched.loading << "s" << std::endl;
+            }
+            std::cout << "  |_ Objectness detection took: " << ctx.timings.objectness << "s" << std::endl;
+            std::cout << "  |_ Hashing verification took: " << ctx.timings.verification << "s" << std::endl;
+            std::cout << "  |_ Template matching took: " << ctx.timings.matching << "s" << std::endl;
+            std::cout << "  |_ NMS took: " << ctx.timings.nms << "s" << std::endl;
+
+            // Vizualize results
+            viz.matches(ctx.scene.pyramid[pyrLvlsDown], ctx.matches, 1);
+        }
+
+        if (ctx.metrics) {
+            dumpMetrics(metrics);
+        }
+
+        // Merge cascade statistics recorded by all threads over the whole run
+        if (criteria->cascadeStats) {
+            CascadeStats stats;
+            CascadeStats::collect(stats);
+            std::cout << std::endl;
+            stats.print(std::cout);
+
+            if (!criteria->metricsPath.empty()) {
+                std::ofstream ofs(criteria->metricsPath + ".cascade.csv");
+                stats.writeCSV(ofs);
+                std::cout << "  |_ cascade -> " << criteria->metricsPath << ".cascade.csv" << std::endl;
+            }
+        }
+
+        if (tracer.isEnabled()) {
+            // Prefetcher may still be building scenes, stop it before writing its events
+            prefetcher.reset();
+            tracer.enable(false);
+
+            if (tracer.write(criteria->tracePath)) {
+                std::cout << "  |_ trace -> " << criteria->tracePath << std::endl;
+            } else {
+                std::cout << "  |_ failed to write trace -> " << criteria->tracePath << std::endl;
+            }
+        }
+    }
 
-            // Vizualize results and clear current matches
-            viz.matches(scene.pyramid[criteria->pyrLvlsDown], matches, 1);
-            matches.clear();
+    void Classifier::dumpMetrics(const Metrics &metrics) const {
+        if (metrics.dump(criteria->metricsPath)) {
+            std::cout << "  |_ metrics -> " << criteria->metricsPath << ".json, " << criteria->metricsPath << ".csv" << std::endl;
+        } else {
+            std::cout << "  |_ failed to write metrics -> " << criteria->metricsPath << std::endl;
         }
     }
-}
\ No newline at end of file
+
+    void Classifier::detect(std::string trainedTemplatesListPath, std::string trainedPath, std::string scenePath, std::vector<uint> objectIds,
+                            std::vector<uint> filterIds) {
+        // Load trained template data
+        if (!load(trainedTemplatesListPath, trainedPath, objectIds)) {
+            return;
+        }
+
+        // Replay recorded scenes
+        DirectoryFrameSource source(scenePath, 0, 503);
+        detect(source, filterIds);
+    }
+}
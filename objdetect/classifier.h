@@ -2,6 +2,7 @@
 #define VSB_SEMESTRAL_PROJECT_CLASSIFIER_H
 
 #include <memory>
+#include <future>
 #include "../core/match.h"
 #include "../core/hash_table.h"
 #include "../utils/parser.h"
@@ -10,6 +11,10 @@
 #include "../core/window.h"
 #include "matcher.h"
 #include "../core/classifier_criteria.h"
+#include "../core/template_bank.h"
+#include "model.h"
+#include "detection_context.h"
+#include "../utils/frame_source.h"
 
 namespace tless {
     /**
@@ -23,21 +28,158 @@ namespace tless {
     class Classifier {
     private:
         cv::Ptr<ClassifierCriteria> criteria;
-        std::vector<Template> templates;
-        std::vector<HashTable> tables;
-        std::vector<Window> windows;
-        std::vector<Match> matches;
+        std::shared_ptr<Model> model; //!< Current model, accessed only through std::atomic_load/store
 
         // Methods
-        void load(const std::string &trainedTemplatesListPath, const std::string &trainedPath);
+        /**
+         * @brief Runs detection on scene parsed in context, using model pinned in context.
+         *
+         * Classifier itself is not modified, so any number of contexts can be processed concurrently.
+         * Stages of each pyramid level form a chain of tasks in a task graph, so that objectness of one level
+         * overlaps verification and matching of others instead of waiting on a barrier after each stage.
+         * Resulting matches (after non-maxima suppression) and stage timings are stored in context.
+         *
+         * @param[in,out] ctx Detection context with pinned model and parsed scene
+         */
+        void detectScene(DetectionContext &ctx) const;
+
+        /**
+         * @brief Builds scene pyramid of the frame using detect params and scene info of given model.
+         *
+         * Pyramid is rebuilt in place, reusing buffers of the previous frame held by the scene.
+         *
+         * @param[in]     model Model the scene is going to be matched against
+         * @param[in]     frame Frame to build scene pyramid from
+         * @param[in,out] scene Scene of previous frame (or empty scene) to rebuild
+         */
+        void createScene(const Model &model, const Frame &frame, Scene &scene) const;
+
+        /**
+         * @brief Records stage latencies and counts of processed frame, both per level and for the whole frame.
+         *
+         * @param[in] ctx              Context of processed frame with metrics sink set
+         * @param[in] matchesBeforeNMS Number of matches of all levels before non-maxima suppression
+         */
+        void recordMetrics(const DetectionContext &ctx, size_t matchesBeforeNMS) const;
+
+        /**
+         * @brief Writes metrics to criteria->metricsPath (.json and .csv).
+         */
+        void dumpMetrics(const Metrics &metrics) const;
 
     public:
         // Constructors
-        Classifier(cv::Ptr<ClassifierCriteria> criteria) : criteria(criteria) {}
+        /**
+         * @brief Creates classifier, criteria->threads and criteria->pinThreads configure shared thread pool if it was not started yet.
+         */
+        Classifier(cv::Ptr<ClassifierCriteria> criteria);
 
         // Methods
         void train(std::string templatesListPath, std::string resultPath, std::vector<uint> indices = {});
-        void detect(std::string trainedTemplatesListPath, std::string trainedPath, std::string scenePath);
+        /**
+         * @brief Loads trained model and runs detection on all scenes in scenePath.
+         *
+         * @param[in] trainedTemplatesListPath Path to file with list of trained per object yml files
+         * @param[in] trainedPath              Path to folder containing classifier.bin or classifier.yml.gz
+         * @param[in] scenePath                Path to folder with scenes
+         * @param[in] objectIds                Ids of objects to load (empty to load all objects)
+         * @param[in] filterIds                Ids of loaded objects to detect, other objects are excluded already in
+         *                                     hashing verification (empty to detect all loaded objects)
+         */
+        void detect(std::string trainedTemplatesListPath, std::string trainedPath, std::string scenePath, std::vector<uint> objectIds = {},
+                    std::vector<uint> filterIds = {});
+
+        /**
+         * @brief Runs detection on all frames of given source, printing timings and visualizing results of each frame.
+         *
+         * Model has to be loaded first (see load()). If criteria->prefetchFrames > 0, next frames are loaded and their
+         * scene pyramids built in background thread while current frame is being matched. If criteria->metricsPath
+         * is set, latencies and counts of all frames are collected into histograms (see Metrics), which are dumped
+         * at the end and whenever the process receives SIGUSR1. If criteria->tracePath is set, spans of all stages and
+         * kernels are recorded and written as Chrome trace-event JSON at the end (see Tracer). If criteria->cascadeStats
+         * is set, statistics of matching cascade are merged from all threads and printed at the end (and written to
+         * metricsPath.cascade.csv if metricsPath is set).
+         *
+         * @param[in] source    Source of frames (directory replay, live feed, ...)
+         * @param[in] filterIds Ids of loaded objects to detect (empty to detect all loaded objects)
+         */
+        void detect(FrameSource &source, std::vector<uint> filterIds = {});
+
+        /**
+         * @brief Runs detection on a single frame using current model, main entry point of streaming detection.
+         *
+         * All per-frame state is held in context, which should be reused for consecutive frames to keep its buffers
+         * warm. Each thread needs its own context, classifier and model are shared. Stage timings of the frame are
+         * available in ctx.timings and are also recorded into ctx.metrics, if set. Returned matches are valid until
+         * the context processes next frame.
+         *
+         * @param[in,out] ctx   Detection context (set objects to detect by ctx.filter())
+         * @param[in]     frame Frame with RGB, 16-bit depth images and 3x3 float intrinsics matrix K
+         * @return            Matches found in the frame (after non-maxima suppression)
+         */
+        const std::vector<Match> &detect(DetectionContext &ctx, const Frame &frame) const;
+
+        /**
+         * @brief Runs detection on a single frame using current model (see detect(DetectionContext&, const Frame&)).
+         *
+         * @param[in,out] ctx   Detection context
+         * @param[in]     rgb   8-bit 3 channel BGR image
+         * @param[in]     depth 16-bit depth image registered to rgb image
+         * @param[in]     K     3x3 float intrinsic camera matrix
+         * @return              Matches found in the frame (after non-maxima suppression)
+         */
+        const std::vector<Match> &detect(DetectionContext &ctx, const cv::Mat &rgb, const cv::Mat &depth, const cv::Mat &K) const;
+
+        /**
+         * @brief Adds objects to already loaded model which was loaded only for subset of objects.
+         *
+         * New model containing union of objects is built and published (see load()). Templates of current model are
+         * reused, only templates and hash table postings of added objects are loaded (see Model::extend).
+         *
+         * @param[in] objectIds Ids of objects to load in addition to already loaded ones (empty to load all objects)
+         * @return              False if the model couldn't be loaded, current model is kept in that case
+         */
+        bool loadObjects(const std::vector<uint> &objectIds);
+
+        /**
+         * @brief Converts trained yml.gz output of train() into binary classifier.bin model in the same folder.
+         *
+         * Detection loads classifier.bin instead of yml files whenever it's present in trainedPath.
+         *
+         * @param[in] trainedTemplatesListPath Path to file with list of trained per object yml files
+         * @param[in] trainedPath              Path to folder containing classifier.yml.gz
+         */
+        void convert(const std::string &trainedTemplatesListPath, const std::string &trainedPath);
+
+        /**
+         * @brief Loads new model and atomically publishes it, replacing current model.
+         *
+         * Frames that already pinned previous model finish with it, previous model is freed when no frame uses it.
+         * Criteria of new model are copied from classifier criteria at the time of loading.
+         *
+         * @param[in] trainedTemplatesListPath Path to file with list of trained per object yml files
+         * @param[in] trainedPath              Path to folder containing classifier.bin or classifier.yml.gz
+         * @param[in] objectIds                Ids of objects to load (empty to load all objects)
+         * @return                             False if the model couldn't be loaded, current model is kept in that case
+         */
+        bool load(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds = {});
+
+        /**
+         * @brief Loads new model in background thread and publishes it once it's loaded (see load()).
+         *
+         * @param[in] trainedTemplatesListPath Path to file with list of trained per object yml files
+         * @param[in] trainedPath              Path to folder containing classifier.bin or classifier.yml.gz
+         * @param[in] objectIds                Ids of objects to load (empty to load all objects)
+         * @return                             Future which becomes ready once new model is published (false if it failed to load)
+         */
+        std::future<bool> reload(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds = {});
+
+        /**
+         * @brief Returns current model, returned pointer keeps the model alive even if it's replaced meanwhile.
+         *
+         * @return Current model (empty if no model was loaded yet)
+         */
+        std::shared_ptr<Model> snapshot() const;
     };
 }
 
@@ -0,0 +1,116 @@
+#include "detection_context.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace tless {
+    void DetectionContext::pin(std::shared_ptr<Model> model) {
+        assert(model);
+
+        // Scratch buffers and mask are indexed by templates of the model
+        if (model != this->model) {
+            this->model = model;
+            mask = TemplateMask(model->templates, filterIds);
+            levels.clear();
+        }
+
+        matches.clear();
+        seeds.clear();
+        timings = Timings();
+    }
+
+    void DetectionContext::filter(const std::vector<uint> &objectIds) {
+        filterIds = objectIds;
+
+        if (model) {
+            mask = TemplateMask(model->templates, filterIds);
+        }
+    }
+
+    void DetectionContext::prepare(size_t count) {
+        assert(model);
+        levels.resize(count);
+
+        for (auto &level : levels) {
+            if (level.votes.size() != model->templates.size()) {
+                level.votes.assign(model->templates.size(), 0);
+#ifdef TLESS_TRACE_VOTES
+                level.triplets.assign(model->templates.size(), {});
+#endif
+                level.voted.clear();
+            }
+
+            level.arena.reset();
+            level.windows.clear();
+            level.matches.clear();
+            level.seeds.clear();
+            level.timings = Timings();
+            level.counts = Counts();
+        }
+    }
+
+    cv::Rect DetectionContext::windowsROI(const std::vector<Window> &windows) const {
+        const ClassifierCriteria &criteria = *model->criteria;
+        assert(!windows.empty());
+
+        // All scales are matched against the same full resolution level, compute features for whole scene
+        if (criteria.depthScaledWindows || criteria.preScaledTemplates) {
+            return cv::Rect();
+        }
+
+        // Candidates matched in window can be as large as the largest template (at window scale), feature points are also matched in patch around them
+        const int offset = criteria.patchOffset;
+        cv::Rect roi;
+
+        for (auto &window : windows) {
+            const cv::Size size(static_cast<int>(criteria.info.largestArea.width / window.scale) + 2 * offset,
+                                static_cast<int>(criteria.info.largestArea.height / window.scale) + 2 * offset);
+            cv::Rect area(window.tl() - cv::Point(offset, offset), size);
+            roi = (roi.area() == 0) ? area : (roi | area);
+        }
+
+        return roi;
+    }
+
+    void DetectionContext::filterWindows(std::vector<Window> &windows, float scale) const {
+        std::vector<cv::Rect> regions;
+        regions.reserve(seeds.size());
+
+        for (auto &seed : seeds) {
+            regions.push_back(seed.scaledBB(seed.normObjBB, 1.0f, scale));
+        }
+
+        windows.erase(std::remove_if(windows.begin(), windows.end(), [&regions](Window &w) {
+            const cv::Rect rect = w.rect();
+            return std::none_of(regions.begin(), regions.end(), [&rect](const cv::Rect &r) { return (r & rect).area() > 0; });
+        }), windows.end());
+    }
+
+    void DetectionContext::filterCandidates(std::vector<Window> &windows, float scale) const {
+        std::vector<cv::Rect> regions;
+        regions.reserve(seeds.size());
+
+        for (auto &seed : seeds) {
+            regions.push_back(seed.scaledBB(seed.normObjBB, 1.0f, scale));
+        }
+
+        for (auto &window : windows) {
+            // Collect objects seeded in the area of the window
+            const cv::Rect rect = window.rect();
+            std::unordered_set<uint> objects;
+
+            for (size_t i = 0; i < regions.size(); ++i) {
+                if ((regions[i] & rect).area() > 0) {
+                    objects.insert(seeds[i].t->objectId());
+                }
+            }
+
+            window.filterCandidates([this, &objects](const Candidate &c) {
+                return objects.find(model->templates[c.index].objectId()) != objects.end();
+            });
+        }
+
+        windows.erase(std::remove_if(windows.begin(), windows.end(), [](Window &w) {
+            return !w.hasCandidates();
+        }), windows.end());
+    }
+}
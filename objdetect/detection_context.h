@@ -0,0 +1,124 @@
+#ifndef VSB_SEMESTRAL_PROJECT_DETECTION_CONTEXT_H
+#define VSB_SEMESTRAL_PROJECT_DETECTION_CONTEXT_H
+
+#include <memory>
+#include <vector>
+#include "model.h"
+#include "../core/scene.h"
+#include "../core/window.h"
+#include "../core/match.h"
+#include "../core/triplet.h"
+#include "../core/template_mask.h"
+#include "../utils/frame_arena.h"
+#include "../utils/metrics.h"
+
+namespace tless {
+    /**
+     * @brief Holds all per-frame scratch state of detection, model itself is only read during detection.
+     *
+     * Each concurrently processed frame needs its own context, any number of contexts can share one model.
+     * Buffers are kept between frames, so reusing one context for consecutive frames avoids reallocation.
+     */
+    class DetectionContext {
+    public:
+        std::shared_ptr<Model> model; //!< Model pinned for currently processed frame
+        TemplateMask mask; //!< Mask of pinned model templates built from filterIds
+        std::vector<uint> filterIds; //!< Ids of objects to detect (empty to detect all objects)
+
+        struct Timings {
+            double sceneLoading = 0, objectness = 0, verification = 0, matching = 0, nms = 0;
+        } timings; //!< Durations of each stage of last processed frame (in seconds, summed over all pyramid levels)
+
+        struct Counts {
+            size_t windows = 0; //!< Windows that passed objectness detection (and coarse-to-fine filtering)
+            size_t candidates = 0; //!< Candidates of all windows that passed hashing verification
+        };
+
+        Metrics *metrics = nullptr; //!< Optional sink of per-frame and per-level metrics, shared by any number of contexts
+
+        /**
+         * @brief State of one pyramid level, levels are processed concurrently so each one has its own windows and scratch.
+         */
+        struct Level {
+            FrameArena arena; //!< Candidates of windows (reset when level is prepared for next frame)
+            std::vector<Window> windows;
+            std::vector<Match> matches;
+            std::vector<Match> seeds; //!< Candidates collected on this level in coarse-to-fine search
+
+            // Hashing verification scratch, indexed by template index in pinned model
+            std::vector<int> votes; //!< Number of votes of each template in currently verified window
+#ifdef TLESS_TRACE_VOTES
+            std::vector<std::vector<Triplet>> triplets; //!< Triplets that voted for each template in currently verified window
+#endif
+            std::vector<size_t> voted; //!< Indices of templates voted for in currently verified window
+            std::vector<Candidate> candidates; //!< Candidates of currently verified window, moved to arena once window is verified
+            cv::Mat edgels, integral; //!< Objectness buffers, kept between frames
+
+            Timings timings; //!< Durations of stages of this level (in seconds)
+            Counts counts; //!< Windows and candidates of this level
+        };
+
+        Scene scene;
+        std::vector<Level> levels;
+        std::vector<Match> matches;
+        std::vector<Match> seeds; //!< Candidates from coarse levels used to restrict search on finer levels
+
+        DetectionContext() = default;
+
+        /**
+         * @brief Pins model for next frame and clears per-frame state, scratch buffers are resized only if model changed.
+         *
+         * @param[in] model Model to use for next frame
+         */
+        void pin(std::shared_ptr<Model> model);
+
+        /**
+         * @brief Sets objects to detect, templates of other objects are excluded in hashing verification.
+         *
+         * @param[in] objectIds Ids of objects to detect (empty to detect all objects)
+         */
+        void filter(const std::vector<uint> &objectIds);
+
+        /**
+         * @brief Prepares state of given number of pyramid levels for next frame, scratch buffers are kept between frames.
+         *
+         * @param[in] count Number of processed pyramid levels
+         */
+        void prepare(size_t count);
+
+        /**
+         * @brief Returns index of template from pinned model in its templates array.
+         */
+        inline size_t index(const Template *t) const {
+            return static_cast<size_t>(t - model->templates.data());
+        }
+
+        /**
+         * @brief Computes region of the scene covered by windows, enlarged to fit any template matched in them.
+         *
+         * Used to restrict lazy computation of pyramid level features only to regions that are actually needed.
+         *
+         * @param[in] windows Windows of processed level
+         * @return            Bounding region of all windows (not clipped to scene size)
+         */
+        cv::Rect windowsROI(const std::vector<Window> &windows) const;
+
+        /**
+         * @brief Removes windows that don't overlap any seed found on coarser pyramid levels.
+         *
+         * @param[in,out] windows Windows of processed level
+         * @param[in]     scale   Scale of the processed level
+         */
+        void filterWindows(std::vector<Window> &windows, float scale) const;
+
+        /**
+         * @brief Removes candidates of objects not seeded in their window on coarser pyramid levels, empty windows are removed.
+         *
+         * @param[in,out] windows Windows of processed level
+         * @param[in]     scale   Scale of the processed level
+         */
+        void filterCandidates(std::vector<Window> &windows, float scale) const;
+    };
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "frame_prefetcher.h"
+#include "../utils/timer.h"
+#include "../utils/tracer.h"
+
+namespace tless {
+    FramePrefetcher::FramePrefetcher(FrameSource &source, size_t depth, std::function<void(Item &)> prepare)
+            : source(source), prepare(std::move(prepare)), queue(depth), spare(depth + 1) {
+        worker = std::thread(&FramePrefetcher::run, this);
+    }
+
+    FramePrefetcher::~FramePrefetcher() {
+        queue.close();
+        worker.join();
+    }
+
+    void FramePrefetcher::run() {
+        Tracer::global().nameThread("prefetcher");
+
+        while (true) {
+            Timer tLoading;
+            Item item;
+
+            {
+                TraceSpan span("loadFrame");
+                if (!source.next(item.frame)) {
+                    break;
+                }
+            }
+
+            // Build into recycled scene if there is any
+            spare.tryPop(item.scene);
+            prepare(item);
+            item.loading = tLoading.elapsed();
+
+            // Blocks while the queue is full, fails once consumer is gone
+            if (!queue.push(std::move(item))) {
+                break;
+            }
+        }
+
+        queue.close();
+    }
+
+    bool FramePrefetcher::next(Item &item) {
+        return queue.pop(item);
+    }
+
+    void FramePrefetcher::recycle(Scene &&scene) {
+        spare.tryPush(std::move(scene));
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef VSB_SEMESTRAL_PROJECT_FRAME_PREFETCHER_H
+#define VSB_SEMESTRAL_PROJECT_FRAME_PREFETCHER_H
+
+#include <thread>
+#include <functional>
+#include "../core/scene.h"
+#include "../utils/frame_source.h"
+#include "../utils/bounded_queue.h"
+#include "model.h"
+
+namespace tless {
+    /**
+     * @brief Loads and preprocesses frames in a background thread ahead of detection.
+     *
+     * Producer thread pulls frames from the source and builds their scene pyramid, while the consumer
+     * detects in previously prepared frames. At most [depth] prepared frames are queued, producer waits
+     * when the queue is full, so memory stays bounded even if detection is slower than loading. Scenes of frames
+     * that were already detected can be handed back by recycle(), worker then rebuilds them in place, so in steady state
+     * the same few scene pyramids circulate between both threads without allocating their images again.
+     */
+    class FramePrefetcher {
+    public:
+        struct Item {
+            Frame frame;
+            std::shared_ptr<Model> model; //!< Model whose criteria were used to build the scene
+            Scene scene; //!< Scene pyramid built from the frame
+            double loading = 0; //!< Time spent loading and preprocessing the frame (in seconds)
+        };
+
+    private:
+        FrameSource &source;
+        std::function<void(Item &)> prepare;
+        BoundedQueue<Item> queue;
+        BoundedQueue<Scene> spare; //!< Recycled scenes, reused by the worker for next frames
+        std::thread worker;
+
+        void run();
+
+    public:
+        /**
+         * @param[in] source  Source of frames, used only from the worker thread until prefetcher is destroyed
+         * @param[in] depth   Maximum number of prepared frames waiting for detection
+         * @param[in] prepare Function filling item.model and item.scene from item.frame (called from the worker thread),
+         *                    item.scene is either empty or recycled scene of some previous frame
+         */
+        FramePrefetcher(FrameSource &source, size_t depth, std::function<void(Item &)> prepare);
+        FramePrefetcher(const FramePrefetcher &) = delete;
+        FramePrefetcher &operator=(const FramePrefetcher &) = delete;
+
+        /**
+         * @brief Stops the worker thread, frames that were not consumed are dropped.
+         */
+        ~FramePrefetcher();
+
+        /**
+         * @brief Returns next prepared frame, blocks until it's ready.
+         *
+         * @param[out] item Next prepared frame
+         * @return          False if source has no more frames
+         */
+        bool next(Item &item);
+
+        /**
+         * @brief Hands scene that is no longer used back to the worker, to be rebuilt for one of the next frames.
+         *
+         * Scene is dropped if there are enough spare scenes already.
+         *
+         * @param[in] scene Scene of already detected frame
+         */
+        void recycle(Scene &&scene);
+    };
+}
+
+#endif
@@ -1,21 +1,24 @@
+#include <algorithm>
 #include <unordered_set>
 #include "hasher.h"
 #include "../utils/timer.h"
 #include "../processing/processing.h"
 #include "../processing/computation.h"
+#include "../utils/thread_pool.h"
+#include "../utils/tracer.h"
 
 namespace tless {
     HashKey Hasher::validateTripletAndComputeHashKey(const Triplet &triplet, const std::vector<cv::Range> &binRanges, const cv::Mat &depth,
-                                                     const cv::Mat &normals, const cv::Mat &gray, cv::Rect window, uchar minGray) {
+                                                     const cv::Mat &normals, const cv::Mat &gray, cv::Rect window, uchar minGray, float scale) {
         // Checks
         assert(depth.type() == CV_16UC1);
         assert(normals.type() == CV_8UC1);
         assert(window.area() > 0);
 
-        // Offset triplet points by template bounding box
-        cv::Point nP1 = triplet.p1 + window.tl();
-        cv::Point nP2 = triplet.p2 + window.tl();
-        cv::Point nC = triplet.c + window.tl();
+        // Offset triplet points by template bounding box (scaled to scene in depth scaled detection)
+        cv::Point nP1 = triplet.p1 * (1.0f / scale) + window.tl();
+        cv::Point nP2 = triplet.p2 * (1.0f / scale) + window.tl();
+        cv::Point nC = triplet.c * (1.0f / scale) + window.tl();
 
         const int brX = window.br().x;
         const int brY = window.br().y;
@@ -58,8 +61,8 @@ namespace tless {
 
         // Quantize depths
         if (!binRanges.empty()) {
-            d1 = quantizeDepth(p1D - cD, binRanges);
-            d2 = quantizeDepth(p2D - cD, binRanges);
+            d1 = quantizeDepth(static_cast<int>((p1D - cD) / scale), binRanges);
+            d2 = quantizeDepth(static_cast<int>((p2D - cD) / scale), binRanges);
         }
 
         // Skip wrong depths
@@ -71,8 +74,7 @@ namespace tless {
     }
 
     void Hasher::initializeBinRanges(std::vector<Template> &templates, std::vector<HashTable> &tables) {
-        #pragma omp parallel for shared(templates, tables)
-        for (size_t i = 0; i < tables.size(); i++) {
+        ThreadPool::global().parallelFor(0, static_cast<int>(tables.size()), [&](int i) {
             const int binCount = criteria->depthBinCount;
             std::vector<int> rDepths;
 
@@ -106,7 +108,7 @@ namespace tless {
 
             // Skip tables with no valid relative depths
             if (binSize == 0) {
-                continue;
+                return;
             } else {
                 for (int j = 0; j < binCount; j++) {
                     int min = rDepths[j * binSize];
@@ -124,7 +126,7 @@ namespace tless {
                 assert(static_cast<int>(ranges.size()) == binCount);
                 tables[i].binRanges = std::move(ranges);
             }
-        }
+        });
     }
 
     void Hasher::train(std::vector<Template> &templates, std::vector<HashTable> &tables) {
@@ -144,8 +146,7 @@ namespace tless {
         initializeBinRanges(templates, tables);
 
         // Fill hash tables with templates at quantized keys
-        #pragma omp parallel for shared(templates, tables) firstprivate(criteria)
-        for (size_t i = 0; i < tables.size(); i++) {
+        ThreadPool::global().parallelFor(0, static_cast<int>(tables.size()), [&](int i) {
             for (auto &t : templates) {
                 // Skip tables with no no defined ranges
                 if (tables[i].binRanges.empty()) {
@@ -163,27 +164,30 @@ namespace tless {
                 // Push unique templates to table
                 tables[i].pushUnique(key, t);
             }
-        }
+        });
 
         // Pick only first 100 tables with the most quantized templates
         std::stable_sort(tables.rbegin(), tables.rend());
         tables.resize(criteria->tablesCount);
     }
 
-    void Hasher::verifyCandidates(const cv::Mat &depth, const cv::Mat &normals, std::vector<HashTable> &tables, std::vector<Window> &windows) {
+    void Hasher::verifyCandidates(const cv::Mat &depth, const cv::Mat &normals, DetectionContext::Level &level, const DetectionContext &ctx) {
+        TraceSpan span("verifyCandidates");
         assert(!normals.empty());
         assert(!depth.empty());
-        assert(!windows.empty());
-        assert(!tables.empty());
+        assert(!level.windows.empty());
+        assert(!ctx.model->tables.empty());
         assert(criteria->info.largestArea.area() > 0);
+        assert(level.votes.size() == ctx.model->templates.size());
 
-        std::vector<Template *> usedTemplates;
+        std::vector<Window> &windows = level.windows;
+        std::vector<Candidate> &candidates = level.candidates;
         std::vector<size_t> emptyIndexes;
 
         for (size_t i = 0; i < windows.size(); ++i) {
-            for (auto &table : tables) {
+            for (auto &table : ctx.model->tables) {
                 // Validate and generate hash key at given triplet point
-                HashKey key = validateTripletAndComputeHashKey(table.triplet, table.binRanges, depth, normals, cv::Mat(), windows[i].rect());
+                HashKey key = validateTripletAndComputeHashKey(table.triplet, table.binRanges, depth, normals, cv::Mat(), windows[i].rect(), 40, windows[i].scale);
 
                 // Skip if validation failed, e.g. key is empty
                 if (key.empty()) {
@@ -192,31 +196,57 @@ namespace tless {
 
                 // Vote for each template in hash table at specific key and push unique to window candidates
                 for (auto &entry : table.templates[key.hash()]) {
-                    entry->votes++;
-                    entry->triplets.push_back(table.triplet); // TODO remove, mostly for debugging
+                    // Skip templates of objects excluded from detection
+                    if (!ctx.mask.allowed(entry)) {
+                        continue;
+                    }
 
-                    // pushes only unique templates with minimum of votes (minVotes) building vector of size up to N
-                    windows[i].pushUnique(entry, criteria->tablesCount, criteria->minVotes);
-                    usedTemplates.push_back(entry);
+                    // Votes are kept in level scratch, so that model is never modified
+                    const size_t index = ctx.index(entry);
+                    if (level.votes[index]++ == 0) {
+                        level.voted.push_back(index);
+                    }
+#ifdef TLESS_TRACE_VOTES
+                    level.triplets[index].push_back(table.triplet);
+#endif
+
+                    pushUnique(candidates, static_cast<uint>(index), level.votes[index], criteria->tablesCount, criteria->minVotes);
                 }
             }
 
             // Sort candidates based on the votes
-            std::stable_sort(windows[i].candidates.begin(), windows[i].candidates.end(), [](Template *t1, Template *t2) { return t1->votes > t2->votes; }); // TODO remove, mostly for debugging
-
-            // Save votes for current window in separate array
-            for (auto &candidate : windows[i].candidates) {
-                windows[i].votes.push_back(candidate->votes);
-                windows[i].triplets.push_back(candidate->triplets); // TODO remove, mostly for debugging
+            std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &c1, const Candidate &c2) {
+                return c1.votes > c2.votes;
+            }); // TODO remove, mostly for debugging
+
+            // Move final candidates to frame arena
+            const auto count = static_cast<int>(candidates.size());
+            windows[i].candidates = level.arena.allocate<Candidate>(candidates.size());
+            windows[i].candidatesCount = count;
+            std::copy(candidates.begin(), candidates.end(), windows[i].candidates);
+
+#ifdef TLESS_TRACE_VOTES
+            // Move triplets that voted for each candidate to frame arena as well
+            windows[i].triplets = level.arena.allocate<CandidateTriplets>(candidates.size());
+            for (int c = 0; c < count; ++c) {
+                const std::vector<Triplet> &triplets = level.triplets[candidates[c].index];
+                Triplet *copy = level.arena.allocate<Triplet>(triplets.size());
+                std::copy(triplets.begin(), triplets.end(), copy);
+                windows[i].triplets[c] = {copy, static_cast<int>(triplets.size())};
             }
+#endif
+
+            candidates.clear();
 
             // Reset votes for all used templates
-            for (auto &t : usedTemplates) {
-                t->votes = 0;
-                t->triplets.clear(); // TODO remove, mostly for debugging
+            for (auto &index : level.voted) {
+                level.votes[index] = 0;
+#ifdef TLESS_TRACE_VOTES
+                level.triplets[index].clear();
+#endif
             }
 
-            usedTemplates.clear();
+            level.voted.clear();
 
             // Save empty windows indexes
             if (!windows[i].hasCandidates()) {
@@ -227,4 +257,4 @@ namespace tless {
         // Remove empty windows
         removeIndex<Window>(windows, emptyIndexes);
     }
-}
\ No newline at end of file
+}
@@ -6,6 +6,7 @@
 #include "../core/hash_table.h"
 #include "../core/classifier_criteria.h"
 #include "../core/window.h"
+#include "detection_context.h"
 
 namespace tless {
     /**
@@ -31,10 +32,12 @@ namespace tless {
          * @param[in] gray      8-bit optional gray image, in training phase we check if the value is above threshold (to validate there's an object)
          * @param[in] window    Triplet positions are being offset to this window size
          * @param[in] minGray   Minimum value of gray image to be considered as containing object
+         * @param[in] scale     Scale of the scene in window relative to templates, triplet points are divided by it and
+         *                      relative depths are divided by it (used in depth scaled detection)
          * @return              Returns valid HashKey if all points and quantized values were valid, otherwise returns empty HashKey
          */
         HashKey validateTripletAndComputeHashKey(const Triplet &triplet, const std::vector<cv::Range> &binRanges, const cv::Mat &depth, const cv::Mat &normals,
-                                              const cv::Mat &gray, cv::Rect window, uchar minGray = 40);
+                                              const cv::Mat &gray, cv::Rect window, uchar minGray = 40, float scale = 1.0f);
 
         /**
          * @brief Computes bin ranges for each table (triplet) across all templates based on relative depths.
@@ -70,14 +73,15 @@ namespace tless {
          * This function computes hash keys on hash table triplets per each window. Then it looks
          * at the contents of hash table at computed key and votes for templates located at that key.
          * This is done for all hash tables. After that we pick 100 best templates (most votes) as
-         * candidates for that specific window.
+         * candidates for that specific window. Templates excluded by context mask are never voted for.
+         * Votes are counted in scratch buffers of the level, model is only read.
          *
          * @param[in]     depth   16-bit Scene depth image
          * @param[in]     normals 8-bit Image of quantized surface normals of scene depth image
-         * @param[in]     tables  Array of pre-computed tables (with generated triplets) in training stage
-         * @param[in,out] windows Array of windows that passed objectness detection test
+         * @param[in,out] level   Level state with windows that passed objectness detection test
+         * @param[in]     ctx     Detection context with pinned model (tables computed in training stage)
          */
-        void verifyCandidates(const cv::Mat &depth, const cv::Mat &normals, std::vector<HashTable> &tables, std::vector<Window> &windows);
+        void verifyCandidates(const cv::Mat &depth, const cv::Mat &normals, DetectionContext::Level &level, const DetectionContext &ctx);
     };
 }
 
@@ -1,6 +1,7 @@
 #include <random>
 #include <algorithm>
 #include <utility>
+#include <mutex>
 #include "matcher.h"
 #include "../core/triplet.h"
 #include "hasher.h"
@@ -11,6 +12,9 @@
 #include "../core/template.h"
 #include "../core/classifier_criteria.h"
 #include "../processing/computation.h"
+#include "../utils/thread_pool.h"
+#include "../utils/tracer.h"
+#include "cascade_stats.h"
 
 namespace tless {
     void Matcher::selectScatteredFeaturePoints(const std::vector<std::pair<cv::Point, uchar>> &points, uint count, std::vector<cv::Point> &scattered) {
@@ -52,8 +56,7 @@ namespace tless {
         assert(minStableVal > 0);
         assert(minEdgeMag > 0);
 
-        #pragma omp parallel for shared(templates) firstprivate(criteria, minStableVal, minEdgeMag)
-        for (size_t i = 0; i < templates.size(); i++) {
+        ThreadPool::global().parallelFor(0, static_cast<int>(templates.size()), [&](int i) {
             Template &t = templates[i];
             std::vector<std::pair<cv::Point, uchar>> edgeVPoints;
             std::vector<std::pair<cv::Point, uchar>> stableVPoints;
@@ -110,11 +113,31 @@ namespace tless {
 //            Visualizer viz(criteria);
 //            viz.tplFeaturePoints(t, 0, "Template feature points");
 #endif
+        });
+    }
+
+    /**
+     * Offsets feature point by window position, feature point coordinates are divided by the scale
+     * of the scene relative to template.
+     */
+    static inline cv::Point offsetPoint(Window &window, const cv::Point &point, float scale) {
+        if (scale == 1.0f) {
+            return window.tl() + point;
+        }
+
+        return window.tl() + cv::Point(cvRound(point.x / scale), cvRound(point.y / scale));
+    }
+
+    float Matcher::candidateScale(const Window &window, const Template *candidate) {
+        if (!criteria->depthScaledWindows || window.depth == 0 || candidate->features.depthMedian == 0) {
+            return 1.0f;
         }
+
+        return window.depth / static_cast<float>(candidate->features.depthMedian);
     }
 
-    int Matcher::testObjectSize(ushort depth, Window &window, cv::Mat &sceneDepth, cv::Point &stable) {
-        auto tl = window.tl() + stable;
+    int Matcher::testObjectSize(ushort depth, Window &window, cv::Mat &sceneDepth, const cv::Point &stable, float scale) {
+        auto tl = offsetPoint(window, stable, scale);
 
         for (int y = -criteria->patchOffset; y <= criteria->patchOffset; ++y) {
             for (int x = -criteria->patchOffset; x <= criteria->patchOffset; ++x) {
@@ -127,7 +150,7 @@ namespace tless {
                     continue;
 
                 // Get depth value at point
-                float sDepth = sceneDepth.at<ushort>(offsetP);
+                float sDepth = sceneDepth.at<ushort>(offsetP) / scale;
 
                 // Validate depth
                 if (sDepth == 0) continue;
@@ -145,8 +168,8 @@ namespace tless {
         return 0;
     }
 
-    int Matcher::testSurfaceNormal(uchar normal, Window &window, cv::Mat &sceneSurfaceNormalsQuantized, cv::Point &stable) {
-        auto tl = window.tl() + stable;
+    int Matcher::testSurfaceNormal(uchar normal, Window &window, cv::Mat &sceneSurfaceNormalsQuantized, const cv::Point &stable, float scale) {
+        auto tl = offsetPoint(window, stable, scale);
 
         for (int y = -criteria->patchOffset; y <= criteria->patchOffset; ++y) {
             for (int x = -criteria->patchOffset; x <= criteria->patchOffset; ++x) {
@@ -167,8 +190,8 @@ namespace tless {
         return 0;
     }
 
-    int Matcher::testGradients(uchar gradient, Window &window, cv::Mat &sceneAnglesQuantized, cv::Point &edge) {
-        auto tl = window.tl() + edge;
+    int Matcher::testGradients(uchar gradient, Window &window, cv::Mat &sceneAnglesQuantized, const cv::Point &edge, float scale) {
+        auto tl = offsetPoint(window, edge, scale);
 
         for (int y = -criteria->patchOffset; y <= criteria->patchOffset; ++y) {
             for (int x = -criteria->patchOffset; x <= criteria->patchOffset; ++x) {
@@ -189,8 +212,8 @@ namespace tless {
         return 0;
     }
 
-    int Matcher::testDepth(float diameter, ushort depthMedian, Window &window, cv::Mat &sceneDepth, cv::Point &stable) {
-        auto tl = window.tl() + stable;
+    int Matcher::testDepth(float diameter, ushort depthMedian, Window &window, cv::Mat &sceneDepth, const cv::Point &stable, float scale) {
+        auto tl = offsetPoint(window, stable, scale);
 
         for (int y = -criteria->patchOffset; y <= criteria->patchOffset; ++y) {
             for (int x = -criteria->patchOffset; x <= criteria->patchOffset; ++x) {
@@ -202,7 +225,7 @@ namespace tless {
                     continue;
                 }
 
-                if ((sceneDepth.at<ushort>(offsetP) - depthMedian) < (criteria->depthK * diameter * criteria->info.depthScaleFactor)) {
+                if ((sceneDepth.at<ushort>(offsetP) / scale - depthMedian) < (criteria->depthK * diameter * criteria->info.depthScaleFactor)) {
                     return 1;
                 }
             }
@@ -211,8 +234,8 @@ namespace tless {
         return 0;
     }
 
-    int Matcher::testColor(uchar hue, Window &window, cv::Mat &sceneHSV, cv::Point &stable) {
-        auto tl = window.tl() + stable;
+    int Matcher::testColor(uchar hue, Window &window, cv::Mat &sceneHSV, const cv::Point &stable, float scale) {
+        auto tl = offsetPoint(window, stable, scale);
 
         for (int y = -criteria->patchOffset; y <= criteria->patchOffset; ++y) {
             for (int x = -criteria->patchOffset; x <= criteria->patchOffset; ++x) {
@@ -233,7 +256,9 @@ namespace tless {
         return 0;
     }
 
-    void Matcher::match(ScenePyramid &scene, std::vector<Window> &windows, std::vector<Match> &matches) {
+    void Matcher::match(ScenePyramid &scene, std::vector<Template> &templates, std::vector<Window> &windows, std::vector<Match> &matches,
+                        const TemplateBank *bank, size_t level, std::vector<Match> *seeds) {
+        TraceSpan span("Matcher::match", static_cast<int>(level));
         // Checks
         assert(!scene.srcDepth.empty());
         assert(!scene.srcNormals.empty());
@@ -249,15 +274,33 @@ namespace tless {
         // Min threshold of matched feature points
         const auto N = criteria->featurePointsCount;
         const auto minThreshold = static_cast<int>(criteria->featurePointsCount * criteria->matchFactor);
-        const long lSize = windows.size();
+        const auto lSize = static_cast<int>(windows.size());
+
+        // When collecting seeds, first three tests use loose threshold
+        const auto looseThreshold = static_cast<int>(criteria->featurePointsCount * criteria->coarseMatchFactor);
+        const int firstThreshold = (seeds != nullptr) ? std::min(minThreshold, looseThreshold) : minThreshold;
 
-        #pragma omp parallel for shared(scene, windows, matches) firstprivate(N, minThreshold)
-        for (int l = 0; l < lSize; l++) {
-            const long canSize =  windows[l].candidates.size();
+        // Cascade statistics are recorded into thread-local instance of the thread processing the window
+        const bool collectStats = criteria->cascadeStats;
+        const int statsLevel = static_cast<int>(level);
+
+        std::mutex mutex;
+        ThreadPool::global().parallelFor(0, lSize, [&](int l) {
+            const int canSize = windows[l].candidatesCount;
+            CascadeStats *cascade = collectStats ? &CascadeStats::local() : nullptr;
 
             for (int c = 0; c < canSize; ++c) {
-                Template *candidate = windows[l].candidates[c];
-                assert(candidate != nullptr);
+                assert(windows[l].candidates[c].index < templates.size());
+                Template *candidate = &templates[windows[l].candidates[c].index];
+                const float scale = candidateScale(windows[l], candidate);
+
+                // Use pre-scaled features when matching against template bank
+                const ScaledTemplate *scaled = (bank != nullptr) ? &bank->get(level, *candidate) : nullptr;
+                const std::vector<cv::Point> &stablePoints = scaled ? scaled->stablePoints : candidate->stablePoints;
+                const std::vector<cv::Point> &edgePoints = scaled ? scaled->edgePoints : candidate->edgePoints;
+                const std::vector<ushort> &depths = scaled ? scaled->depths : candidate->features.depths;
+                const ushort depthMedian = scaled ? scaled->depthMedian : candidate->features.depthMedian;
+                const float diameter = scaled ? scaled->diameter : candidate->diameter;
 
 #ifndef NDEBUG
 //                // Vizualization
@@ -265,11 +308,11 @@ namespace tless {
 //
 //                // Save validation for all points
 //                for (uint i = 0; i < N; i++) {
-//                    vsI.emplace_back(candidate->stablePoints[i], testObjectSize(candidate->features.depths[i], windows[l], scene.srcDepth, candidate->stablePoints[i]));
-//                    vsII.emplace_back(candidate->stablePoints[i], testSurfaceNormal(candidate->features.normals[i], windows[l], scene.srcNormals, candidate->stablePoints[i]));
-//                    vsIII.emplace_back(candidate->edgePoints[i], testGradients(candidate->features.gradients[i], windows[l], scene.srcGradients, candidate->edgePoints[i]));
-//                    vsIV.emplace_back(candidate->stablePoints[i], testDepth(candidate->diameter, candidate->features.depthMedian, windows[l], scene.srcDepth, candidate->stablePoints[i]));
-//                    vsV.emplace_back(candidate->stablePoints[i], testColor(candidate->features.hue[i], windows[l], scene.srcHue, candidate->stablePoints[i]));
+//                    vsI.emplace_back(stablePoints[i], testObjectSize(depths[i], windows[l], scene.srcDepth, stablePoints[i], scale));
+//                    vsII.emplace_back(stablePoints[i], testSurfaceNormal(candidate->features.normals[i], windows[l], scene.srcNormals, stablePoints[i], scale));
+//                    vsIII.emplace_back(edgePoints[i], testGradients(candidate->features.gradients[i], windows[l], scene.srcGradients, edgePoints[i], scale));
+//                    vsIV.emplace_back(stablePoints[i], testDepth(diameter, depthMedian, windows[l], scene.srcDepth, stablePoints[i], scale));
+//                    vsV.emplace_back(stablePoints[i], testColor(candidate->features.hue[i], windows[l], scene.srcHue, stablePoints[i], scale));
 //                }
 //
 //                // Push each score to scores vector
@@ -283,49 +326,73 @@ namespace tless {
                 // Scores for each test
                 float sI = 0, sII = 0, sIII = 0, sIV = 0, sV = 0;
 
+                // Bounding box is defined at the scale of the candidate (equal to scene scale in image pyramid)
+                const float levelScale = scale * (scaled ? bank->scales[level] : 1.0f);
+                const float matchScale = scene.scale * levelScale;
+                cv::Rect matchBB = cv::Rect(cvRound(windows[l].tl().x * levelScale), cvRound(windows[l].tl().y * levelScale), candidate->objBB.width, candidate->objBB.height);
+
+                // Statistics of the cascade, each test is timed from the end of the previous one
+                CascadeStats::Tests *stats = cascade ? &cascade->at(statsLevel, candidate->objectId()) : nullptr;
+                int64_t tTest = stats ? CascadeStats::now() : 0;
+
                 // Test I
                 for (uint i = 0; i < N; i++) {
-                    sI += testObjectSize(candidate->features.depths[i], windows[l], scene.srcDepth, candidate->stablePoints[i]);
+                    sI += testObjectSize(depths[i], windows[l], scene.srcDepth, stablePoints[i], scale);
                 }
 
-                if (sI < minThreshold) continue;
+                if (stats) tTest = stats->record(0, sI, N, sI >= firstThreshold, tTest);
+                if (sI < firstThreshold) continue;
 
                 // Test II
                 for (uint i = 0; i < N; i++) {
-                    sII += testSurfaceNormal(candidate->features.normals[i], windows[l], scene.srcNormals, candidate->stablePoints[i]);
+                    sII += testSurfaceNormal(candidate->features.normals[i], windows[l], scene.srcNormals, stablePoints[i], scale);
                 }
 
-                if (sII < minThreshold) continue;
+                if (stats) tTest = stats->record(1, sII, N, sII >= firstThreshold, tTest);
+                if (sII < firstThreshold) continue;
 
                 // Test III
                 for (uint i = 0; i < N; i++) {
-                    sIII += testGradients(candidate->features.gradients[i], windows[l], scene.srcGradients, candidate->edgePoints[i]);
+                    sIII += testGradients(candidate->features.gradients[i], windows[l], scene.srcGradients, edgePoints[i], scale);
                 }
 
-                if (sIII < minThreshold) continue;
+                if (stats) stats->record(2, sIII, N, sIII >= firstThreshold, tTest);
+                if (sIII < firstThreshold) continue;
+
+                // Candidates passing reduced cascade with loose threshold are used as seeds for finer levels
+                if (seeds != nullptr) {
+                    float seedScore = (sI / N) + (sII / N) + (sIII / N);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    seeds->emplace_back(candidate, matchBB, matchScale, seedScore, seedScore * (candidate->objArea / matchScale), sI, sII, sIII, 0, 0);
+
+                    if (sI < minThreshold || sII < minThreshold || sIII < minThreshold) continue;
+                }
 
                 // Test IV
+                if (stats) tTest = CascadeStats::now();
                 for (uint i = 0; i < N; i++) {
-                    sIV += testDepth(candidate->diameter, candidate->features.depthMedian, windows[l], scene.srcDepth, candidate->stablePoints[i]);
+                    sIV += testDepth(diameter, depthMedian, windows[l], scene.srcDepth, stablePoints[i], scale);
                 }
 
+                if (stats) tTest = stats->record(3, sIV, N, sIV >= minThreshold, tTest);
                 if (sIV < minThreshold) continue;
 
                 // Test V
                 for (uint i = 0; i < N; i++) {
-                    sV += testColor(candidate->features.hue[i], windows[l], scene.srcHue, candidate->stablePoints[i]);
+                    sV += testColor(candidate->features.hue[i], windows[l], scene.srcHue, stablePoints[i], scale);
                 }
 
+                if (stats) stats->record(4, sV, N, sV >= minThreshold, tTest);
                 if (sV < minThreshold) continue;
 
                 // Push template that passed all tests to matches array
                 float score = (sI / N) + (sII / N) + (sIII / N) + (sIV / N) + (sV / N);
-                cv::Rect matchBB = cv::Rect(windows[l].tl().x, windows[l].tl().y, candidate->objBB.width, candidate->objBB.height);
 
                 // This section is almost never executed at the same time, as the tests do have non-uniform results, also most of the windows never passes the fifth test
-                #pragma omp critical
-                matches.emplace_back(candidate, matchBB, scene.scale, score, score * (candidate->objArea / scene.scale), sI, sII, sIII, sIV, sV);
+                std::lock_guard<std::mutex> lock(mutex);
+                matches.emplace_back(candidate, matchBB, matchScale, score, score * (candidate->objArea / matchScale), sI, sII, sIII, sIV, sV);
             }
-        }
+        });
     }
 }
@@ -8,6 +8,7 @@
 #include "../core/match.h"
 #include "../core/classifier_criteria.h"
 #include "../core/scene.h"
+#include "../core/template_bank.h"
 
 namespace tless {
     /**
@@ -30,12 +31,24 @@ namespace tless {
         void selectScatteredFeaturePoints(const std::vector<std::pair<cv::Point, uchar>> &points,
                                           uint count, std::vector<cv::Point> &scattered);
 
-        // Tests
-        inline int testObjectSize(ushort depth, Window &window, cv::Mat &sceneDepth, cv::Point &stable); // Test I
-        inline int testSurfaceNormal(uchar normal, Window &window, cv::Mat &sceneSurfaceNormalsQuantized, cv::Point &stable); // Test II
-        inline int testGradients(uchar gradient, Window &window, cv::Mat &sceneAnglesQuantized, cv::Point &edge); // Test III
-        inline int testDepth(float diameter, ushort depthMedian, Window &window, cv::Mat &sceneDepth, cv::Point &stable); // Test IV
-        inline int testColor(uchar hue, Window &window, cv::Mat &sceneHSV, cv::Point &stable); // Test V
+        /**
+         * @brief Returns scale of the scene in window relative to the candidate template.
+         *
+         * In depth scaled detection (criteria.depthScaledWindows) it's computed from scene depth in window center
+         * and candidate depth median, otherwise the scene is already scaled by image pyramid and 1 is returned.
+         *
+         * @param[in] window    Window the candidate is matched in
+         * @param[in] candidate Matched candidate
+         * @return              Scale of the scene relative to the candidate template
+         */
+        float candidateScale(const Window &window, const Template *candidate);
+
+        // Tests, feature point offsets are divided and scene depths are divided by the candidate scale
+        inline int testObjectSize(ushort depth, Window &window, cv::Mat &sceneDepth, const cv::Point &stable, float scale); // Test I
+        inline int testSurfaceNormal(uchar normal, Window &window, cv::Mat &sceneSurfaceNormalsQuantized, const cv::Point &stable, float scale); // Test II
+        inline int testGradients(uchar gradient, Window &window, cv::Mat &sceneAnglesQuantized, const cv::Point &edge, float scale); // Test III
+        inline int testDepth(float diameter, ushort depthMedian, Window &window, cv::Mat &sceneDepth, const cv::Point &stable, float scale); // Test IV
+        inline int testColor(uchar hue, Window &window, cv::Mat &sceneHSV, const cv::Point &stable, float scale); // Test V
 
     public:
         Matcher(cv::Ptr<ClassifierCriteria> criteria) : criteria(criteria) {}
@@ -51,11 +64,25 @@ namespace tless {
          * sum of matched points. After all windows have been tested, non-maxima suppression is applied to all matches to filter out the
          * best candidates which are than retained in the final matches vector.
          *
-         * @param[in]  scene   Current scene in image scale pyramid
-         * @param[in]  windows Windows array that passed objectness detection test with candidates filtered in hasher verification
+         * When template bank is provided (criteria.preScaledTemplates), candidates are matched using their features
+         * pre-scaled for given level of the bank, scene is expected to be at full resolution.
+         *
+         * When seeds are requested (coarse-to-fine search), tests I-III use looser [criteria.coarseMatchFactor] threshold
+         * and every candidate passing them is pushed to seeds, candidates are then matched with regular threshold.
+         *
+         * If criteria.cascadeStats is set, candidates entering and rejected by each test, evaluated and matched feature points
+         * and time spent in each test are recorded per level and object id into CascadeStats::local() of the matching thread.
+         *
+         * @param[in]  scene     Current scene in image scale pyramid
+         * @param[in]  templates Templates of the model, referenced by candidate indices
+         * @param[in]  windows   Windows array that passed objectness detection test with candidates filtered in hasher verification
          * @param[out] matches Final array foound matches
+         * @param[in]  bank    Optional bank of pre-scaled templates
+         * @param[in]  level   Level (scale) of the template bank to match
+         * @param[out] seeds   Optional array of candidates that passed reduced cascade with loose threshold
          */
-        void match(ScenePyramid &scene, std::vector<Window> &windows, std::vector<Match> &matches);
+        void match(ScenePyramid &scene, std::vector<Template> &templates, std::vector<Window> &windows, std::vector<Match> &matches,
+                   const TemplateBank *bank = nullptr, size_t level = 0, std::vector<Match> *seeds = nullptr);
 
         /**
          * @brief Generates feature points and extract features for each template.
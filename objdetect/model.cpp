@@ -0,0 +1,223 @@
+#include "model.h"
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include "../utils/timer.h"
+#include "../utils/model_file.h"
+#include "../processing/computation.h"
+#include "../utils/thread_pool.h"
+
+namespace tless {
+    bool Model::loadYml(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds) {
+        std::ifstream ifs(trainedTemplatesListPath);
+        assert(ifs.is_open());
+
+        std::vector<std::string> paths;
+        std::string path;
+        while (ifs >> path) {
+            paths.push_back(path);
+        }
+
+        // Load trained data of each object concurrently
+        const auto pathsSize = static_cast<int>(paths.size());
+        std::vector<std::vector<Template>> objects(paths.size());
+
+        ThreadPool::global().parallelFor(0, pathsSize, [&](int i) {
+            cv::FileStorage fsr(paths[i], cv::FileStorage::READ);
+            cv::FileNode tpls = fsr["templates"];
+
+            // Loop through templates, templates of objects that were not requested are dropped by their object id
+            for (auto &&t : tpls) {
+                objects[i].emplace_back();
+                t >> objects[i].back();
+
+                if (!objectIds.empty() && std::find(objectIds.begin(), objectIds.end(), objects[i].back().objectId()) == objectIds.end()) {
+                    objects[i].pop_back();
+                }
+            }
+
+            fsr.release();
+        });
+
+        // Merge objects in order of the list into single preallocated array
+        size_t templatesCount = templates.size();
+        for (auto &object : objects) {
+            templatesCount += object.size();
+        }
+        templates.reserve(templatesCount);
+
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (objects[i].empty()) {
+                std::cout << "  |_ " << paths[i] << " -> SKIPPED" << std::endl;
+                continue;
+            }
+
+            std::move(objects[i].begin(), objects[i].end(), std::back_inserter(templates));
+            std::cout << "  |_ " << paths[i] << " -> LOADED (" << objects[i].size() << ")" << std::endl;
+        }
+
+        // Load data set
+        cv::FileStorage fsr(trainedPath + "classifier.yml.gz", cv::FileStorage::READ);
+        fsr["criteria"] >> criteria;
+        std::cout << "  |_ info -> LOADED" << std::endl;
+        std::cout << "  |_ loading hashtables..." << std::endl;
+
+        // Decode hash tables in parallel, postings are resolved through single id -> index map of the model
+        indices = HashTable::indexTemplates(templates);
+        cv::FileNode hashTables = fsr["tables"];
+        const auto tablesSize = static_cast<int>(hashTables.size());
+        const size_t offset = tables.size();
+        std::atomic<bool> valid(true);
+        tables.resize(offset + tablesSize);
+
+        ThreadPool::global().parallelFor(0, tablesSize, [&](int i) {
+            cv::FileNode table = hashTables[i];
+            if (!HashTable::load(table, templates, indices, tables[offset + i])) {
+                valid = false;
+            }
+        });
+
+        fsr.release();
+        if (!valid) {
+            templates.clear();
+            indices.clear();
+            tables.clear();
+            std::cout << "  |_ hashTables -> CORRUPTED" << std::endl;
+            return false;
+        }
+
+        std::cout << "  |_ hashTables -> LOADED (" << tables.size() << ")" << std::endl;
+        return true;
+    }
+
+    bool Model::loadTrained(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds) {
+        // Prefer binary model, fallback to per object yml files
+        ModelFile file;
+        if (file.open(trainedPath + "classifier.bin") && file.read(criteria, templates, tables, objectIds)) {
+            indices = HashTable::indexTemplates(templates);
+            std::cout << "  |_ " << trainedPath + "classifier.bin -> LOADED (" << templates.size() << " templates, "
+                      << tables.size() << " hash tables)" << std::endl;
+            return true;
+        }
+
+        if (file.templatesCount() > 0) {
+            std::cout << "  |_ " << trainedPath + "classifier.bin -> CORRUPTED, falling back to yml" << std::endl;
+        }
+
+        return loadYml(trainedTemplatesListPath, trainedPath, objectIds);
+    }
+
+    void Model::prepare() {
+        // Compute median depth of all templates, used as reference depth in depth scaled detection
+        std::vector<ushort> depthMedians;
+        for (auto &t : templates) {
+            depthMedians.push_back(t.features.depthMedian);
+        }
+        if (!depthMedians.empty()) {
+            criteria->info.medianDepth = median<ushort>(depthMedians);
+        }
+
+        // Pre-scale templates for each scale of image pyramid
+        if (criteria->preScaledTemplates) {
+            std::vector<float> scales;
+            for (int l = -criteria->pyrLvlsDown; l <= criteria->pyrLvlsUp; ++l) {
+                scales.push_back(std::pow(criteria->pyrScaleFactor, l));
+            }
+
+            bank.build(templates, indices, scales);
+            std::cout << "  |_ template bank -> BUILT (" << scales.size() << " scales, "
+                      << bank.memory() / (1024.0 * 1024.0) << " MB)" << std::endl;
+        }
+    }
+
+    bool Model::load(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds) {
+        Timer tLoading;
+        std::cout << "Loading trained templates... " << std::endl;
+
+        // Remember model sources so that other objects can be loaded later
+        listPath = trainedTemplatesListPath;
+        path = trainedPath;
+        this->objectIds = objectIds;
+
+        if (!loadTrained(trainedTemplatesListPath, trainedPath, objectIds)) {
+            std::cout << "FAILED!, took: " << tLoading.elapsed() << " s" << std::endl << std::endl;
+            return false;
+        }
+
+        if (!objectIds.empty()) {
+            std::cout << "  |_ objects -> " << objectIds.size() << " requested" << std::endl;
+        }
+
+        prepare();
+        std::cout << "DONE!, took: " << tLoading.elapsed() << " s" << std::endl << std::endl;
+        return true;
+    }
+
+    bool Model::extend(const Model &base, const std::vector<uint> &objectIds) {
+        assert(!base.objectIds.empty());
+        assert(!objectIds.empty());
+
+        Timer tLoading;
+        std::cout << "Loading templates of additional objects... " << std::endl;
+
+        listPath = base.listPath;
+        path = base.path;
+        this->objectIds = base.objectIds;
+        this->objectIds.insert(this->objectIds.end(), objectIds.begin(), objectIds.end());
+
+        // Only new objects are decoded, with postings of their templates only
+        Model added(*criteria);
+        if (!added.loadTrained(listPath, path, objectIds) || added.tables.size() != base.tables.size()) {
+            std::cout << "FAILED!, took: " << tLoading.elapsed() << " s" << std::endl << std::endl;
+            return false;
+        }
+
+        // Templates of base model are copied, templates of new objects are appended behind them
+        const size_t offset = base.templates.size();
+        criteria = added.criteria;
+        templates.reserve(offset + added.templates.size());
+        templates.insert(templates.end(), base.templates.begin(), base.templates.end());
+        std::move(added.templates.begin(), added.templates.end(), std::back_inserter(templates));
+
+        indices = base.indices;
+        for (size_t i = offset; i < templates.size(); ++i) {
+            indices[templates[i].id] = i;
+        }
+
+        // Merge postings of both models, pointers are rebased by their index into the merged templates array
+        const Template *baseData = base.templates.data();
+        const Template *addedData = added.templates.data();
+        const auto tablesSize = static_cast<int>(base.tables.size());
+        tables.resize(base.tables.size());
+
+        ThreadPool::global().parallelFor(0, tablesSize, [&](int i) {
+            const HashTable &from = base.tables[i], &extra = added.tables[i];
+            HashTable &table = tables[i];
+            table.triplet = from.triplet;
+            table.binRanges = from.binRanges;
+            table.size = from.size + extra.size;
+
+            for (size_t key = 0; key < table.templates.size(); ++key) {
+                auto &bucket = table.templates[key];
+                bucket.reserve(from.templates[key].size() + extra.templates[key].size());
+
+                for (const Template *t : from.templates[key]) {
+                    bucket.push_back(&templates[t - baseData]);
+                }
+
+                for (const Template *t : extra.templates[key]) {
+                    bucket.push_back(&templates[offset + (t - addedData)]);
+                }
+            }
+        });
+
+        std::cout << "  |_ objects -> " << objectIds.size() << " added to " << base.objectIds.size() << " loaded ("
+                  << added.templates.size() << " templates)" << std::endl;
+
+        prepare();
+        std::cout << "DONE!, took: " << tLoading.elapsed() << " s" << std::endl << std::endl;
+        return true;
+    }
+}
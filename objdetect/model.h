@@ -0,0 +1,90 @@
+#ifndef VSB_SEMESTRAL_PROJECT_MODEL_H
+#define VSB_SEMESTRAL_PROJECT_MODEL_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <opencv2/core/mat.hpp>
+#include "../core/template.h"
+#include "../core/hash_table.h"
+#include "../core/template_bank.h"
+#include "../core/classifier_criteria.h"
+
+namespace tless {
+    /**
+     * @brief Snapshot of loaded trained classifier (criteria, templates, hash tables and template bank).
+     *
+     * Hash tables point directly into templates array of the same model, so model can't be copied and is
+     * never modified after it's loaded. Classifier shares models through std::shared_ptr, detection pins
+     * current model for the whole frame, so new model can be published while frames are still processed
+     * and the old one is freed when the last frame using it finishes.
+     */
+    class Model {
+    private:
+        /**
+         * @brief Loads criteria, templates and hash tables (binary classifier.bin if present, yml files otherwise).
+         */
+        bool loadTrained(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds);
+
+        /**
+         * @brief Computes data derived from loaded templates (median depth and template bank).
+         */
+        void prepare();
+
+    public:
+        cv::Ptr<ClassifierCriteria> criteria; //!< Copy of classifier criteria at the time of loading with trained params of this model
+        std::vector<Template> templates;
+        std::unordered_map<uint, size_t> indices; //!< Template id -> index in templates array, shared by hash tables, bank and model file
+        std::vector<HashTable> tables;
+        TemplateBank bank;
+
+        // Model sources
+        std::string listPath, path;
+        std::vector<uint> objectIds; //!< Ids of loaded objects, empty if all objects are loaded
+
+        /**
+         * @brief Creates empty model, criteria are copied so that loading of trained params doesn't modify running detection.
+         *
+         * @param[in] criteria Classifier criteria (detect params)
+         */
+        explicit Model(const ClassifierCriteria &criteria) : criteria(new ClassifierCriteria(criteria)) {}
+        Model(const Model &) = delete;
+        Model &operator=(const Model &) = delete;
+
+        /**
+         * @brief Loads trained model (binary classifier.bin if present, yml files otherwise).
+         *
+         * @param[in] trainedTemplatesListPath Path to file with list of trained per object yml files
+         * @param[in] trainedPath              Path to folder containing classifier.bin or classifier.yml.gz
+         * @param[in] objectIds                Ids of objects to load, templates of other objects are skipped
+         *                                     and removed from hash tables (empty to load all objects)
+         * @return                             False if neither binary model nor yml files could be loaded
+         */
+        bool load(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds);
+
+        /**
+         * @brief Loads trained templates from per object yml files and criteria with hash tables from classifier.yml.gz.
+         *
+         * @param[in] trainedTemplatesListPath Path to file with list of trained per object yml files
+         * @param[in] trainedPath              Path to folder containing classifier.yml.gz
+         * @param[in] objectIds                Ids of objects to load (empty to load all objects)
+         * @return                             False if stored hash tables are corrupted, templates and tables are left empty
+         */
+        bool loadYml(const std::string &trainedTemplatesListPath, const std::string &trainedPath, const std::vector<uint> &objectIds);
+
+        /**
+         * @brief Builds model with objects of base model and additional objects loaded from the same sources.
+         *
+         * Templates of base model are copied instead of being decoded again, only templates and postings of additional
+         * objects are loaded and appended to hash tables of base model. Derived data (median depth, template bank)
+         * are recomputed for all templates.
+         *
+         * @param[in] base      Model loaded for subset of objects
+         * @param[in] objectIds Ids of objects to add, none of them may be loaded in base model already
+         * @return              False if additional objects couldn't be loaded
+         */
+        bool extend(const Model &base, const std::vector<uint> &objectIds);
+    };
+}
+
+#endif
@@ -3,26 +3,25 @@
 #include "../processing/processing.h"
 
 namespace tless {
-    void Objectness::objectness(cv::Mat &src, std::vector<Window> &windows) {
+    void Objectness::objectness(cv::Mat &src, std::vector<Window> &windows, cv::Mat &edgels, cv::Mat &integral, float scale) {
         assert(criteria->info.smallestTemplate.area() > 0);
         assert(criteria->info.minEdgels > 0);
         assert(criteria->objectnessFactor > 0);
         assert(!src.empty());
         assert(src.type() == CV_16U);
 
-        // Normalize min and max depths to look for objectness in
-        auto minDepth = static_cast<int>(criteria->info.minDepth * depthNormalizationFactor(criteria->info.minDepth, criteria->depthDeviationFun));
-        auto maxDepth = static_cast<int>(criteria->info.maxDepth / depthNormalizationFactor(criteria->info.maxDepth, criteria->depthDeviationFun));
+        // Normalize min and max depths to look for objectness in, level depths are divided by scale
+        auto minDepth = static_cast<int>(scale * criteria->info.minDepth * depthNormalizationFactor(criteria->info.minDepth, criteria->depthDeviationFun));
+        auto maxDepth = static_cast<int>(scale * criteria->info.maxDepth / depthNormalizationFactor(criteria->info.maxDepth, criteria->depthDeviationFun));
 
-        // Generate integral image of detected edgels
-        cv::Mat edgels, integral;
-        auto minMag = static_cast<int>(criteria->objectnessDiameterThreshold * criteria->info.smallestDiameter * criteria->info.depthScaleFactor);
+        // Generate integral image of detected edgels, magnitude threshold is scaled the same way as depths
+        auto minMag = static_cast<int>(scale * criteria->objectnessDiameterThreshold * criteria->info.smallestDiameter * criteria->info.depthScaleFactor);
         depthEdgels(src, edgels, minDepth, maxDepth, minMag);
         cv::integral(edgels, integral, CV_32S);
 
-        const auto minEdgels = static_cast<const int>(criteria->info.minEdgels * criteria->objectnessFactor);
-        const int sizeX = criteria->info.smallestTemplate.width;
-        const int sizeY = criteria->info.smallestTemplate.height;
+        const auto minEdgels = static_cast<const int>(criteria->info.minEdgels * criteria->objectnessFactor / scale);
+        const auto sizeX = static_cast<int>(criteria->info.smallestTemplate.width / scale);
+        const auto sizeY = static_cast<int>(criteria->info.smallestTemplate.height / scale);
 
         // Slide window over scene and calculate edge count for each overlap
         for (int y = 0; y < integral.rows - sizeY; y += criteria->windowStep) {
@@ -33,7 +32,59 @@ namespace tless {
                                   - integral.at<int>(y + sizeY, x) + integral.at<int>(y, x);
 
                 if (sceneEdgels >= minEdgels) {
-                    windows.emplace_back(x, y, sizeX, sizeY, sceneEdgels);
+                    windows.emplace_back(x, y, sizeX, sizeY, sceneEdgels, scale, 0);
+                }
+            }
+        }
+    }
+
+    void Objectness::objectnessScaled(cv::Mat &src, std::vector<Window> &windows, cv::Mat &edgels, cv::Mat &integral) {
+        assert(criteria->info.smallestTemplate.area() > 0);
+        assert(criteria->info.minEdgels > 0);
+        assert(criteria->info.medianDepth > 0);
+        assert(criteria->objectnessFactor > 0);
+        assert(!src.empty());
+        assert(src.type() == CV_16U);
+
+        // Range of scales, that would be covered by image pyramid
+        const float minScale = 1.0f / std::pow(criteria->pyrScaleFactor, criteria->pyrLvlsDown);
+        const float maxScale = std::pow(criteria->pyrScaleFactor, criteria->pyrLvlsUp);
+
+        // Normalize min and max depths to look for objectness in, extended by the range of scales
+        auto minDepth = static_cast<int>(minScale * criteria->info.minDepth * depthNormalizationFactor(criteria->info.minDepth, criteria->depthDeviationFun));
+        auto maxDepth = static_cast<int>(maxScale * criteria->info.maxDepth / depthNormalizationFactor(criteria->info.maxDepth, criteria->depthDeviationFun));
+
+        // Generate integral image of detected edgels, magnitude threshold is relaxed to the smallest scale
+        auto minMag = static_cast<int>(minScale * criteria->objectnessDiameterThreshold * criteria->info.smallestDiameter * criteria->info.depthScaleFactor);
+        depthEdgels(src, edgels, minDepth, maxDepth, minMag);
+        cv::integral(edgels, integral, CV_32S);
+
+        const float minEdgels = criteria->info.minEdgels * criteria->objectnessFactor;
+        const int baseX = criteria->info.smallestTemplate.width;
+        const int baseY = criteria->info.smallestTemplate.height;
+
+        // Slide window center over scene, window size is picked by scene depth at its center
+        for (int cY = 0; cY < src.rows; cY += criteria->windowStep) {
+            for (int cX = 0; cX < src.cols; cX += criteria->windowStep) {
+                // Get scale at current location
+                ushort depth = src.at<ushort>(cY, cX);
+                if (depth == 0) continue;
+
+                const float scale = depth / static_cast<float>(criteria->info.medianDepth);
+                if (scale < minScale || scale > maxScale) continue;
+
+                // Objects further away are smaller, edgels count grows linearly with object size
+                const auto sizeX = static_cast<int>(baseX / scale);
+                const auto sizeY = static_cast<int>(baseY / scale);
+                const int x = cX - sizeX / 2, y = cY - sizeY / 2;
+                if (x < 0 || y < 0 || x + sizeX >= integral.cols || y + sizeY >= integral.rows) continue;
+
+                // Calc edgel count value in current sliding window with help of image integral
+                int sceneEdgels = integral.at<int>(y + sizeY, x + sizeX) - integral.at<int>(y, x + sizeX)
+                                  - integral.at<int>(y + sizeY, x) + integral.at<int>(y, x);
+
+                if (sceneEdgels >= minEdgels / scale) {
+                    windows.emplace_back(x, y, sizeX, sizeY, sceneEdgels, scale, depth);
                 }
             }
         }
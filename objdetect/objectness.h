@@ -28,10 +28,35 @@ namespace tless {
          * at least 30% (criteria->objectnessFactor) of edgels of the template containing least amount
          * of them (criteria->info.minEdgels), extracted during training phase
          *
-         * @param[in]  src     Source 16-bit depth image (in mm)
-         * @param[out] windows Contains all window positions, that were detected as containing object
+         * Optional scale emulates detection at pyramid level of given scale on full resolution depth image (used with
+         * pre-scaled templates), depth range, edgel magnitudes, window size and edgels count are scaled accordingly.
+         *
+         * @param[in]     src      Source 16-bit depth image (in mm)
+         * @param[out]    windows  Contains all window positions, that were detected as containing object
+         * @param[in,out] edgels   Buffer for depth edgels, reused if it already has the size of src
+         * @param[in,out] integral Buffer for integral image of edgels, reused if it already has the right size
+         * @param[in]     scale    Scale of the pyramid level to emulate, windows are marked by this scale
+         */
+        void objectness(cv::Mat &src, std::vector<Window> &windows, cv::Mat &edgels, cv::Mat &integral, float scale = 1.0f);
+
+        /**
+         * @brief Applies objectness detection on full resolution depth image with window size derived from scene depth.
+         *
+         * Used instead of image pyramid (criteria.depthScaledWindows). At each sliding window location scale is computed
+         * from scene depth d in the center of the window as s = d / criteria.info.medianDepth, window size is then
+         * criteria.info.smallestTemplate / s and edgels threshold is scaled accordingly. Only scales that would be covered
+         * by the image pyramid <1 / pyrScaleFactor^pyrLvlsDown, pyrScaleFactor^pyrLvlsUp> are considered. Windows are
+         * slid by their center, so depth is always sampled in the center of the scaled window.
+         *
+         * Candidates are not known yet, so windows are sized by the median depth of all templates. Each candidate is
+         * then matched at its own scale window.depth / depthMedian (see Matcher::candidateScale).
+         *
+         * @param[in]     src      Source 16-bit depth image (in mm) at full resolution
+         * @param[out]    windows  Contains all window positions with their scale and depth, that were detected as containing object
+         * @param[in,out] edgels   Buffer for depth edgels, reused if it already has the size of src
+         * @param[in,out] integral Buffer for integral image of edgels, reused if it already has the right size
          */
-        void objectness(cv::Mat &src, std::vector<Window> &windows);
+        void objectnessScaled(cv::Mat &src, std::vector<Window> &windows, cv::Mat &edgels, cv::Mat &integral);
     };
 }
 
@@ -0,0 +1,47 @@
+#include "pyramid_planner.h"
+#include <numeric>
+#include <limits>
+#include "../processing/processing.h"
+
+namespace tless {
+    std::vector<bool> PyramidPlanner::plan(const cv::Mat &depth, const std::vector<float> &scales) {
+        assert(!depth.empty());
+        assert(depth.type() == CV_16U);
+        assert(criteria->info.maxDepth > 0);
+        assert(criteria->info.smallestTemplate.area() > 0);
+
+        // Cumulative histogram of valid depths, cumulative[i] holds count of depths in bins lower than i
+        const int bins = (std::numeric_limits<ushort>::max() + 1) / BIN_SIZE;
+        std::vector<long> cumulative(bins + 1, 0);
+
+        for (int y = 0; y < depth.rows; y++) {
+            for (int x = 0; x < depth.cols; x++) {
+                ushort d = depth.at<ushort>(y, x);
+                if (d > 0) cumulative[d / BIN_SIZE + 1]++;
+            }
+        }
+
+        std::partial_sum(cumulative.begin(), cumulative.end(), cumulative.begin());
+
+        // Normalize trained depths, the same way as in objectness detection
+        const float minDepth = criteria->info.minDepth * depthNormalizationFactor(criteria->info.minDepth, criteria->depthDeviationFun);
+        const float maxDepth = criteria->info.maxDepth / depthNormalizationFactor(criteria->info.maxDepth, criteria->depthDeviationFun);
+        const float minArea = criteria->info.smallestTemplate.area() * criteria->pyrMinCoverage;
+        std::vector<bool> feasible(scales.size());
+
+        for (size_t i = 0; i < scales.size(); i++) {
+            // Trained depth range at this level corresponds to this range of full resolution depths
+            const float from = minDepth * scales[i];
+            const float to = maxDepth * scales[i];
+
+            const int fromBin = std::min(bins, static_cast<int>(from) / BIN_SIZE);
+            const int toBin = (to >= bins * BIN_SIZE) ? bins : static_cast<int>(to) / BIN_SIZE + 1;
+            const long count = cumulative[toBin] - cumulative[fromBin];
+
+            // Template sized object at this level covers (area / scale^2) pixels of the full resolution image
+            feasible[i] = count >= minArea / (scales[i] * scales[i]);
+        }
+
+        return feasible;
+    }
+}
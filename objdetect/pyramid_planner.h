@@ -0,0 +1,40 @@
+#ifndef VSB_SEMESTRAL_PROJECT_PYRAMID_PLANNER_H
+#define VSB_SEMESTRAL_PROJECT_PYRAMID_PLANNER_H
+
+#include <vector>
+#include <opencv2/core/mat.hpp>
+#include "../core/classifier_criteria.h"
+
+namespace tless {
+    /**
+     * @brief Selects levels of scene image pyramid that can geometrically contain any of the trained objects.
+     *
+     * Depth values of each pyramid level are divided by its scale, so objects can only be found at levels
+     * where some part of the scene falls into trained depth range (criteria.info.minDepth, criteria.info.maxDepth)
+     * after rescaling. Levels with not enough such pixels to cover a template sized object are skipped.
+     */
+    class PyramidPlanner {
+    private:
+        cv::Ptr<ClassifierCriteria> criteria;
+
+    public:
+        static const int BIN_SIZE = 256; //!< Width of one bin of the scene depth histogram (in depth units)
+
+        explicit PyramidPlanner(cv::Ptr<ClassifierCriteria> criteria) : criteria(criteria) {}
+
+        /**
+         * @brief Decides which pyramid levels should be built and processed based on scene depth histogram.
+         *
+         * Level at scale s is feasible if the full resolution depth image contains at least
+         * [criteria.pyrMinCoverage * criteria.info.smallestTemplate.area() / s^2] valid pixels in depth range
+         * [s * minDepth, s * maxDepth], where min and max depths are trained depths normalized by depth error function.
+         *
+         * @param[in] depth  Source 16-bit depth image at full resolution (depth values not rescaled)
+         * @param[in] scales Scales of all pyramid levels
+         * @return           Array of flags for each level, true if the level should be processed
+         */
+        std::vector<bool> plan(const cv::Mat &depth, const std::vector<float> &scales);
+    };
+}
+
+#endif
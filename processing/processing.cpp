@@ -1,6 +1,8 @@
 #include "processing.h"
 #include "../objdetect/hasher.h"
 #include "computation.h"
+#include "../utils/thread_pool.h"
+#include "../utils/tracer.h"
 #include <cassert>
 #include <opencv2/imgproc.hpp>
 #include <iostream>
@@ -37,16 +39,22 @@ namespace tless {
 
     // TODO - consider refactoring and sending scale along with other params, max depth and difference can be than modified inside this function ranther than outside
     void quantizedNormals(const cv::Mat &src, cv::Mat &dst, float fx, float fy, int maxDepth, int maxDifference) {
+        cv::Mat buffer;
+        quantizedNormals(src, dst, fx, fy, maxDepth, maxDifference, buffer);
+    }
+
+    void quantizedNormals(const cv::Mat &src, cv::Mat &dst, float fx, float fy, int maxDepth, int maxDifference, cv::Mat &buffer) {
+        TraceSpan span("quantizedNormals");
         assert(!src.empty());
         assert(src.type() == CV_16UC1);
 
         int PS = 5; // patch size
-        dst = cv::Mat::zeros(src.size(), CV_8UC1);
+        buffer.create(src.size(), CV_8UC1);
+        buffer.setTo(0);
         auto offsetX = static_cast<int>(NORMAL_LUT_SIZE * 0.5f);
         auto offsetY = static_cast<int>(NORMAL_LUT_SIZE * 0.5f);
 
-        #pragma omp parallel for default(none) shared(src, dst, NORMAL_LUT) firstprivate(fx, fy, maxDepth, maxDifference, PS, offsetX, offsetY)
-        for (int y = PS; y < src.rows - PS; y++) {
+        ThreadPool::global().parallelFor(PS, src.rows - PS, [&](int y) {
             for (int x = PS; x < src.cols - PS; x++) {
                 // Get depth value at (x,y)
                 long d = src.at<ushort>(y, x);
@@ -93,30 +101,32 @@ namespace tless {
                         // auto vZ = static_cast<int>(Nz * NORMAL_LUT_SIZE + NORMAL_LUT_SIZE);
 
                         // Save quantized normals, ignore vZ, we quantize only in top half of sphere (cone)
-                        dst.at<uchar>(y, x) = NORMAL_LUT[vY][vX];
-                        // dst.at<uchar>(y, x) = static_cast<uchar>(std::fabs(Nz) * 255); // Lambert
+                        buffer.at<uchar>(y, x) = NORMAL_LUT[vY][vX];
+                        // buffer.at<uchar>(y, x) = static_cast<uchar>(std::fabs(Nz) * 255); // Lambert
                     } else {
-                        dst.at<uchar>(y, x) = 0; // Discard shadows & distant objects from depth sensor
+                        buffer.at<uchar>(y, x) = 0; // Discard shadows & distant objects from depth sensor
                     }
                 } else {
-                    dst.at<uchar>(y, x) = 0; // Wrong depth
+                    buffer.at<uchar>(y, x) = 0; // Wrong depth
                 }
             }
-        }
+        }, 8);
 
-        cv::medianBlur(dst, dst, 5);
+        // Filter out of place, in place median filter would copy the whole source
+        cv::medianBlur(buffer, dst, 5);
     }
 
     void depthEdgels(const cv::Mat &src, cv::Mat &dst, int minDepth, int maxDepth, int minMag) {
+        TraceSpan span("depthEdgels");
         assert(!src.empty());
         assert(src.type() == CV_16U);
 
         const int filterX[9] = {-1, 0, 1, -2, 0, 2, -1, 0, 1};
         const int filterY[9] = {-1, -2, -1, 0, 0, 0, 1, 2, 1};
-        dst = cv::Mat::zeros(src.size(), CV_8UC1);
+        dst.create(src.size(), CV_8UC1);
+        dst.setTo(0);
 
-        #pragma omp parallel for default(none) shared(src, dst, filterX, filterY) firstprivate(minDepth, maxDepth, minMag)
-        for (int y = 1; y < src.rows - 1; y++) {
+        ThreadPool::global().parallelFor(1, src.rows - 1, [&](int y) {
             for (int x = 1; x < src.cols - 1; x++) {
                 int i = 0, sumX = 0, sumY = 0;
                 bool skip = false;
@@ -143,7 +153,7 @@ namespace tless {
 
                 dst.at<uchar>(y, x) = static_cast<uchar>((std::sqrt(sqr<float>(sumX) + sqr<float>(sumY)) > minMag) ? 1 : 0);
             }
-        }
+        }, 8);
     }
 
     float depthNormalizationFactor(float depth, const std::vector<cv::Vec2f>& errorFunction) {
@@ -178,7 +188,7 @@ namespace tless {
 
     void normalizeHSV(const cv::Mat &src, cv::Mat &dst, uchar value, uchar saturation) {
         // TODO debug the best values for saturation and value
-        dst = cv::Mat(src.size(), CV_8UC1);
+        dst.create(src.size(), CV_8UC1);
 
         for (int y = 0; y < src.rows; y++) {
             for (int x = 0; x < src.cols; x++) {
@@ -198,6 +208,7 @@ namespace tless {
     }
 
     void nms(std::vector<Match> &matches, float maxOverlap) {
+        TraceSpan span("nms");
         if (matches.empty()) return;
 
         // Sort all matches by their highest score
@@ -255,29 +266,33 @@ namespace tless {
     }
 
     void quantizedGradients(const cv::Mat &src, cv::Mat &dst, float minMag) {
+        cv::Mat gradX, gradY;
+        cv::Mat bgr[3], angles[3], mags[3];
+        quantizedGradients(src, dst, minMag, bgr, gradX, gradY, mags, angles);
+    }
+
+    void quantizedGradients(const cv::Mat &src, cv::Mat &dst, float minMag, cv::Mat *bgr, cv::Mat &gradX, cv::Mat &gradY,
+                            cv::Mat *mags, cv::Mat *angles) {
+        TraceSpan span("quantizedGradients");
         assert(src.type() == CV_8UC3);
 
         // Split rgb to planes
-        cv::Mat gradX, gradY, srcNorm;
-        cv::Mat bgr[3], angles[3], mags[3];
         cv::split(src, bgr);
 
         for (int i = 0; i < 3; ++i) {
-            bgr[i].convertTo(srcNorm, CV_32FC1, 1.0f / 255.0f);
-
-            // Compute sobel
-            cv::Sobel(bgr[i], gradX, CV_32F, 1, 0, 3, 1, 0);
-            cv::Sobel(bgr[i], gradY, CV_32F, 0, 1, 3, 1, 0);
+            // Compute sobel, planes may be views into larger buffers, never look outside of them
+            cv::Sobel(bgr[i], gradX, CV_32F, 1, 0, 3, 1, 0, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+            cv::Sobel(bgr[i], gradY, CV_32F, 0, 1, 3, 1, 0, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
 
             // Compute angles and magnitudes
             cv::cartToPolar(gradX, gradY, mags[i], angles[i], true);
         }
 
         // Quantize orientations
-        dst = cv::Mat::zeros(src.size(), CV_8UC1);
+        dst.create(src.size(), CV_8UC1);
+        dst.setTo(0);
 
-        #pragma omp parallel for default(none) shared(dst, angles, mags) firstprivate(minMag)
-        for (int y = 0; y < dst.rows; y++) {
+        ThreadPool::global().parallelFor(0, dst.rows, [&](int y) {
             for (int x = 0; x < dst.cols; x++) {
                 float mag1 = mags[0].at<float>(y, x);
                 float mag2 = mags[1].at<float>(y, x);
@@ -303,7 +318,75 @@ namespace tless {
                 // Quantize orientations
                 dst.at<uchar>(y, x) = quantizeGradientOrientation(angles[maxIndex].at<float>(y, x));
             }
+        }, 8);
+    }
+
+    void poolQuantized(const cv::Mat &src, cv::Mat &dst, cv::Size size) {
+        assert(!src.empty());
+        assert(src.type() == CV_8UC1);
+        assert(size.width <= src.cols && size.height <= src.rows);
+
+        float ratioX = src.cols / static_cast<float>(size.width);
+        float ratioY = src.rows / static_cast<float>(size.height);
+        dst.create(size, CV_8UC1);
+        dst.setTo(0);
+
+        ThreadPool::global().parallelFor(0, dst.rows, [&](int y) {
+            // Source rows covered by current destination pixel
+            const int sY = static_cast<int>(y * ratioY);
+            const int eY = std::min(src.rows, std::max(sY + 1, static_cast<int>(std::ceil((y + 1) * ratioY))));
+
+            for (int x = 0; x < dst.cols; x++) {
+                const int sX = static_cast<int>(x * ratioX);
+                const int eX = std::min(src.cols, std::max(sX + 1, static_cast<int>(std::ceil((x + 1) * ratioX))));
+                int counts[8] = {0}, zeros = 0;
+
+                // Count occurrences of each quantized value in covered area
+                for (int yy = sY; yy < eY; yy++) {
+                    for (int xx = sX; xx < eX; xx++) {
+                        uchar value = src.at<uchar>(yy, xx);
+
+                        if (value == 0) {
+                            zeros++;
+                        } else {
+                            counts[hashValue(value)]++;
+                        }
+                    }
+                }
+
+                // Pick the most frequent value, invalid (0) values win ties
+                int maxI = 0;
+                for (int i = 1; i < 8; i++) {
+                    if (counts[i] > counts[maxI]) { maxI = i; }
+                }
+
+                if (counts[maxI] > zeros) {
+                    dst.at<uchar>(y, x) = static_cast<uchar>(1 << maxI);
+                }
+            }
+        }, 8);
+    }
+
+    float quantizedAgreement(const cv::Mat &a, const cv::Mat &b) {
+        assert(a.type() == CV_8UC1 && b.type() == CV_8UC1);
+        assert(a.size() == b.size());
+
+        long valid = 0, equal = 0;
+
+        for (int y = 0; y < a.rows; y++) {
+            for (int x = 0; x < a.cols; x++) {
+                uchar vA = a.at<uchar>(y, x);
+                uchar vB = b.at<uchar>(y, x);
+
+                // Skip pixels invalid in both maps
+                if (vA == 0 && vB == 0) continue;
+
+                valid++;
+                if (vA == vB) equal++;
+            }
         }
+
+        return valid > 0 ? equal / static_cast<float>(valid) : 1.0f;
     }
 
     uchar quantizeGradientOrientation(float deg) {
@@ -45,6 +45,21 @@ namespace tless {
      */
     void quantizedNormals(const cv::Mat &src, cv::Mat &dst, float fx, float fy, int maxDepth, int maxDifference);
 
+    /**
+     * @brief Computes quantized surface normals from 16-bit depth image without allocating any image (see quantizedNormals).
+     *
+     * Destination and buffer are written in place when they already have the size of the source image.
+     *
+     * @param[in]     src           Source 16-bit depth image (in mm)
+     * @param[out]    dst           Destination 8-bit image, where each bit represents one bin of view cone
+     * @param[in]     fx            Camera focal length in X direction
+     * @param[in]     fy            Camera focal length in Y direction
+     * @param[in]     maxDepth      Ignore pixels beyond this depth
+     * @param[in]     maxDifference Ignore contributions of pixels whose depth difference with central pixel is above this threshold
+     * @param[in,out] buffer        Buffer holding normals before median filtering
+     */
+    void quantizedNormals(const cv::Mat &src, cv::Mat &dst, float fx, float fy, int maxDepth, int maxDifference, cv::Mat &buffer);
+
     /**
      * @brief Generates binary image of visible depth edgels, detected in depth image within (min, max) depths.
      *
@@ -113,6 +128,45 @@ namespace tless {
      */
     void quantizedGradients(const cv::Mat &src, cv::Mat &dst, float minMag);
 
+    /**
+     * @brief Computes and quantizes gradient orientations over RGB scene, intermediate images are kept in given buffers.
+     *
+     * All images are written in place when they already have the size of the source image.
+     *
+     * @param[in]     src    8-bit 3-channel RGB image to compute gradients on
+     * @param[out]    dst    8-bit image map of quantized gradient orientations
+     * @param[in]     minMag Minimum edge magnitude to consider as valid and compute orientation for
+     * @param[in,out] bgr    Buffers for color planes (3)
+     * @param[in,out] gradX  Buffer for sobel in X direction
+     * @param[in,out] gradY  Buffer for sobel in Y direction
+     * @param[in,out] mags   Buffers for magnitudes of each color plane (3)
+     * @param[in,out] angles Buffers for orientations of each color plane (3)
+     */
+    void quantizedGradients(const cv::Mat &src, cv::Mat &dst, float minMag, cv::Mat *bgr, cv::Mat &gradX, cv::Mat &gradY,
+                            cv::Mat *mags, cv::Mat *angles);
+
+    /**
+     * @brief Downscales map of quantized (one-hot) features using majority pooling.
+     *
+     * Each destination pixel covers area of the source map given by the ratio of both sizes and is
+     * assigned the most frequent value in that area (0 included), so the result stays one-hot and can be used
+     * in place of features recomputed on the downscaled images.
+     *
+     * @param[in]  src  8-bit map of quantized features (surface normals or gradient orientations)
+     * @param[out] dst  8-bit pooled map of quantized features
+     * @param[in]  size Size of the destination map (smaller or equal to src size)
+     */
+    void poolQuantized(const cv::Mat &src, cv::Mat &dst, cv::Size size);
+
+    /**
+     * @brief Computes agreement of two maps of quantized features.
+     *
+     * @param[in] a First 8-bit map of quantized features
+     * @param[in] b Second 8-bit map of quantized features of the same size
+     * @return      Fraction [0-1] of pixels, where at least one map is non-zero, having equal values in both maps
+     */
+    float quantizedAgreement(const cv::Mat &a, const cv::Mat &b);
+
     /**
      * @brief Quantizes orientation gradients into 5 bins (0-180deg) based on their angle
      *
@@ -0,0 +1,105 @@
+#ifndef VSB_SEMESTRAL_PROJECT_BOUNDED_QUEUE_H
+#define VSB_SEMESTRAL_PROJECT_BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace tless {
+    /**
+     * @brief Blocking FIFO queue of limited capacity, used to pass work between producer and consumer threads.
+     *
+     * Producer blocks in push() while the queue is full (back-pressure), consumer blocks in pop() while it's empty.
+     * Once closed, push() drops new items and pop() returns remaining items and then fails.
+     *
+     * @tparam T Type of queued items (movable)
+     */
+    template<typename T>
+    class BoundedQueue {
+    private:
+        std::deque<T> items;
+        size_t capacity;
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable notFull, notEmpty;
+
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+        /**
+         * @brief Pushes item to the queue, blocks while the queue is full.
+         *
+         * @param[in] item Item to push
+         * @return         False if queue was closed and item was dropped
+         */
+        bool push(T &&item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+            if (closed) return false;
+
+            items.push_back(std::move(item));
+            notEmpty.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Pops the oldest item from the queue, blocks while the queue is empty and not closed.
+         *
+         * @param[out] item Popped item
+         * @return          False if queue is closed and empty
+         */
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+            if (items.empty()) return false;
+
+            item = std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Pushes item to the queue only if it's not full, never blocks.
+         *
+         * @param[in] item Item to push
+         * @return         False if queue is full or closed and item was dropped
+         */
+        bool tryPush(T &&item) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed || items.size() >= capacity) return false;
+
+            items.push_back(std::move(item));
+            notEmpty.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Pops the oldest item from the queue only if there is any, never blocks.
+         *
+         * @param[out] item Popped item
+         * @return          False if queue is empty
+         */
+        bool tryPop(T &item) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (items.empty()) return false;
+
+            item = std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Closes the queue and wakes up all waiting threads.
+         */
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            notFull.notify_all();
+            notEmpty.notify_all();
+        }
+    };
+}
+
+#endif
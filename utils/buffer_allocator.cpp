@@ -0,0 +1,79 @@
+#include <cassert>
+#include <cstdlib>
+#include "buffer_allocator.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace tless {
+    BufferAllocator *BufferAllocator::get(bool hugePages) {
+        static BufferAllocator aligned(false), huge(true);
+        return hugePages ? &huge : &aligned;
+    }
+
+    cv::UMatData *BufferAllocator::allocate(int dims, const int *sizes, int type, void *data0, size_t *step,
+                                            int, cv::UMatUsageFlags) const {
+        // Compute continuous steps (same as the default allocator, rows are not padded)
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--) {
+            if (step) {
+                if (data0 && step[i] != CV_AUTOSTEP) {
+                    assert(total <= step[i]);
+                    total = step[i];
+                } else {
+                    step[i] = total;
+                }
+            }
+
+            total *= sizes[i];
+        }
+
+        auto *u = new cv::UMatData(this);
+        u->size = total;
+
+        if (data0) {
+            u->data = u->origdata = static_cast<uchar *>(data0);
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+            return u;
+        }
+
+        // Huge pages are only used when the whole allocation is made of them
+        const size_t alignment = hugePages ? HUGE_PAGE : CACHE_LINE;
+        const size_t size = (total + alignment - 1) & ~(alignment - 1);
+
+        void *data = nullptr;
+        if (posix_memalign(&data, alignment, size) != 0) {
+            delete u;
+            CV_Error(cv::Error::StsNoMem, "Failed to allocate image buffer");
+        }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (hugePages) {
+            // Only an advice, allocation stays valid (backed by regular pages) if THP are disabled
+            madvise(data, size, MADV_HUGEPAGE);
+        }
+#endif
+
+        u->data = u->origdata = static_cast<uchar *>(data);
+        return u;
+    }
+
+    bool BufferAllocator::allocate(cv::UMatData *data, int, cv::UMatUsageFlags) const {
+        return data != nullptr;
+    }
+
+    void BufferAllocator::deallocate(cv::UMatData *u) const {
+        if (!u) return;
+
+        assert(u->urefcount == 0);
+        assert(u->refcount == 0);
+
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+            std::free(u->origdata);
+            u->origdata = nullptr;
+        }
+
+        delete u;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef VSB_SEMESTRAL_PROJECT_BUFFER_ALLOCATOR_H
+#define VSB_SEMESTRAL_PROJECT_BUFFER_ALLOCATOR_H
+
+#include <cstddef>
+#include <opencv2/core/mat.hpp>
+
+namespace tless {
+    /**
+     * @brief Allocator of long-lived image buffers, that are allocated once and rewritten in place for each frame.
+     *
+     * Data of each matrix starts at cache line boundary. If huge pages are requested, data is aligned to
+     * and rounded up to the size of a huge page and the kernel is advised to back it by transparent huge pages
+     * (Linux only), which cuts TLB misses of kernels sweeping over whole images. Rounding wastes up to 2MB
+     * per buffer, so it's meant only for buffers that live as long as the detection does.
+     */
+    class BufferAllocator : public cv::MatAllocator {
+    public:
+        static const size_t CACHE_LINE = 64;
+        static const size_t HUGE_PAGE = 2 << 20;
+
+    private:
+        bool hugePages;
+
+        explicit BufferAllocator(bool hugePages) : hugePages(hugePages) {}
+
+    public:
+        /**
+         * @brief Returns shared allocator instance (allocators are stateless and thread-safe).
+         *
+         * @param[in] hugePages Back buffers by transparent huge pages
+         */
+        static BufferAllocator *get(bool hugePages = false);
+
+        cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                               int flags, cv::UMatUsageFlags usageFlags) const override;
+        bool allocate(cv::UMatData *data, int accessFlags, cv::UMatUsageFlags usageFlags) const override;
+        void deallocate(cv::UMatData *data) const override;
+    };
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include <cassert>
+#include <algorithm>
+#include "frame_arena.h"
+
+namespace tless {
+    void *FrameArena::allocateBytes(size_t size, size_t alignment) {
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+        while (current < blocks.size()) {
+            // Align offset from the block start, blocks themselves are aligned by operator new[]
+            const size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+
+            if (aligned + size <= blocks[current].size) {
+                offset = aligned + size;
+                return blocks[current].data.get() + aligned;
+            }
+
+            // Continue in next kept block
+            ++current;
+            offset = 0;
+        }
+
+        // All blocks are used up, add a new one
+        Block block;
+        block.size = std::max(blockSize, size + alignment);
+        block.data.reset(new unsigned char[block.size]);
+        blocks.push_back(std::move(block));
+
+        current = blocks.size() - 1;
+        offset = size;
+        return blocks[current].data.get();
+    }
+
+    void FrameArena::reset() {
+        current = 0;
+        offset = 0;
+    }
+
+    size_t FrameArena::capacity() const {
+        size_t size = 0;
+        for (auto &block : blocks) {
+            size += block.size;
+        }
+
+        return size;
+    }
+}
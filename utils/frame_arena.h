@@ -0,0 +1,67 @@
+#ifndef VSB_SEMESTRAL_PROJECT_FRAME_ARENA_H
+#define VSB_SEMESTRAL_PROJECT_FRAME_ARENA_H
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+namespace tless {
+    /**
+     * @brief Bump allocator for per-frame data, all allocations are released at once by reset().
+     *
+     * Memory is taken from large blocks which are kept between frames, so after the first few frames
+     * no allocation reaches malloc. Only trivially destructible types can be allocated, as no destructors
+     * are ever called. Arena is not thread-safe, each concurrently running stage needs its own arena.
+     */
+    class FrameArena {
+    private:
+        struct Block {
+            std::unique_ptr<unsigned char[]> data;
+            size_t size;
+        };
+
+        std::vector<Block> blocks;
+        size_t blockSize;
+        size_t current = 0; //!< Index of the block allocations are currently taken from
+        size_t offset = 0; //!< Offset of the first free byte in current block
+
+        void *allocateBytes(size_t size, size_t alignment);
+
+    public:
+        /**
+         * @param[in] blockSize Size of each block in bytes (larger requests get their own block)
+         */
+        explicit FrameArena(size_t blockSize = 1 << 20) : blockSize(blockSize) {}
+        FrameArena(const FrameArena &) = delete;
+        FrameArena &operator=(const FrameArena &) = delete;
+        FrameArena(FrameArena &&) = default;
+        FrameArena &operator=(FrameArena &&) = default;
+
+        /**
+         * @brief Allocates uninitialized array of count elements, valid until next reset().
+         *
+         * @param[in] count Number of elements
+         * @return          Pointer to the first element (nullptr if count is 0)
+         */
+        template<typename T>
+        T *allocate(size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "Arena never calls destructors");
+            if (count == 0) return nullptr;
+
+            return static_cast<T *>(allocateBytes(count * sizeof(T), alignof(T)));
+        }
+
+        /**
+         * @brief Releases all allocations in O(1), blocks are kept for next frame.
+         */
+        void reset();
+
+        /**
+         * @brief Returns total size of all blocks in bytes.
+         */
+        size_t capacity() const;
+    };
+}
+
+#endif
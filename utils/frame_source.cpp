@@ -0,0 +1,12 @@
+#include "frame_source.h"
+#include "parser.h"
+
+namespace tless {
+    bool DirectoryFrameSource::next(Frame &frame) {
+        if (end >= 0 && index >= end) {
+            return false;
+        }
+
+        return Parser::parseFrame(basePath, index++, frame);
+    }
+}
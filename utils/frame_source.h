@@ -0,0 +1,45 @@
+#ifndef VSB_SEMESTRAL_PROJECT_FRAME_SOURCE_H
+#define VSB_SEMESTRAL_PROJECT_FRAME_SOURCE_H
+
+#include <string>
+#include "../core/scene.h"
+
+namespace tless {
+    /**
+     * @brief Interface of frame providers for streaming detection (recorded scenes, live sensor feeds, ...).
+     */
+    class FrameSource {
+    public:
+        virtual ~FrameSource() = default;
+
+        /**
+         * @brief Provides next frame, blocks until the frame is available.
+         *
+         * @param[out] frame Next frame
+         * @return           False if there are no more frames
+         */
+        virtual bool next(Frame &frame) = 0;
+    };
+
+    /**
+     * @brief Replays frames of T-LESS scene folder (rgb/, depth/ folders and info.yml) in order of their indices.
+     */
+    class DirectoryFrameSource : public FrameSource {
+    private:
+        std::string basePath;
+        int index, end;
+
+    public:
+        /**
+         * @param[in] basePath Base path to scene folder with info.yml and rgb, depth folders
+         * @param[in] first    Index of the first frame
+         * @param[in] count    Maximum number of frames to replay, negative to replay until images are missing
+         */
+        explicit DirectoryFrameSource(const std::string &basePath, int first = 0, int count = -1)
+                : basePath(basePath), index(first), end(count < 0 ? -1 : first + count) {}
+
+        bool next(Frame &frame) override;
+    };
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cmath>
+#include "histogram.h"
+
+namespace tless {
+    Histogram::Histogram(const std::string &unit) : unit(unit), counts(new std::atomic<uint64_t>[BUCKETS]) {
+        reset();
+    }
+
+    int Histogram::bucketIndex(int64_t value) {
+        // Values below 2 * 64 are stored exactly, each next power of two shifts sub-bucket by one more bit
+        int highest = 63 - __builtin_clzll(static_cast<uint64_t>(value) | 1);
+        int shift = std::max(0, highest - SUB_BUCKET_BITS);
+
+        return (shift << SUB_BUCKET_BITS) + static_cast<int>(value >> shift);
+    }
+
+    int64_t Histogram::bucketLow(int index) {
+        int shift = std::max(0, (index >> SUB_BUCKET_BITS) - 1);
+        return static_cast<int64_t>(index - (shift << SUB_BUCKET_BITS)) << shift;
+    }
+
+    int64_t Histogram::bucketHigh(int index) {
+        int shift = std::max(0, (index >> SUB_BUCKET_BITS) - 1);
+        return bucketLow(index) + (int64_t(1) << shift) - 1;
+    }
+
+    void Histogram::record(int64_t value) {
+        value = std::min(std::max(value, int64_t(0)), (int64_t(1) << MAX_BITS) - 1);
+
+        counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(static_cast<uint64_t>(value), std::memory_order_relaxed);
+
+        int64_t current = minValue.load(std::memory_order_relaxed);
+        while (value < current && !minValue.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+
+        current = maxValue.load(std::memory_order_relaxed);
+        while (value > current && !maxValue.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    int64_t Histogram::percentile(double percentile) const {
+        const uint64_t n = count();
+        if (n == 0) return 0;
+
+        // Rank of the value at percentile (at least the first value)
+        percentile = std::min(std::max(percentile, 0.0), 100.0);
+        auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * n)));
+        uint64_t seen = 0;
+
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(bucketHigh(i), max());
+            }
+        }
+
+        return max();
+    }
+
+    uint64_t Histogram::count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    int64_t Histogram::min() const {
+        return count() > 0 ? minValue.load(std::memory_order_relaxed) : 0;
+    }
+
+    int64_t Histogram::max() const {
+        return maxValue.load(std::memory_order_relaxed);
+    }
+
+    double Histogram::mean() const {
+        const uint64_t n = count();
+        return n > 0 ? sum.load(std::memory_order_relaxed) / static_cast<double>(n) : 0;
+    }
+
+    const std::string &Histogram::getUnit() const {
+        return unit;
+    }
+
+    void Histogram::reset() {
+        for (int i = 0; i < BUCKETS; ++i) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+
+        total = 0;
+        sum = 0;
+        minValue = INT64_MAX;
+        maxValue = 0;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef VSB_SEMESTRAL_PROJECT_HISTOGRAM_H
+#define VSB_SEMESTRAL_PROJECT_HISTOGRAM_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace tless {
+    /**
+     * @brief HDR-style histogram of non-negative integer values (latencies in microseconds or counts).
+     *
+     * Values are kept in log-linear buckets: every power of two range is split into 64 equal sub-buckets, so any
+     * recorded value is represented with relative error below 1.6% regardless of its magnitude (values below 128
+     * are exact). Range is [0, 2^40), larger values are clamped. Recording is lock-free, so concurrently processed
+     * pyramid levels can record into the same histogram.
+     */
+    class Histogram {
+    public:
+        static const int SUB_BUCKET_BITS = 6; //!< 64 sub-buckets per power of two
+        static const int MAX_BITS = 40; //!< Largest recordable value is 2^40 - 1
+        static const int BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    private:
+        std::string unit; //!< Unit of recorded values (empty for counts)
+        std::unique_ptr<std::atomic<uint64_t>[]> counts;
+        std::atomic<uint64_t> total{0}, sum{0};
+        std::atomic<int64_t> minValue{INT64_MAX}, maxValue{0};
+
+        static int bucketIndex(int64_t value);
+        static int64_t bucketLow(int index);
+        static int64_t bucketHigh(int index);
+
+    public:
+        /**
+         * @param[in] unit Unit of recorded values used in dumps (e.g. "us"), empty for counts
+         */
+        explicit Histogram(const std::string &unit = "");
+        Histogram(const Histogram &) = delete;
+        Histogram &operator=(const Histogram &) = delete;
+
+        /**
+         * @brief Records one occurrence of value, negative values are recorded as 0.
+         */
+        void record(int64_t value);
+
+        /**
+         * @brief Value at given percentile [0-100], reported as the highest value equivalent to the found bucket.
+         *
+         * @param[in] percentile Percentile to get value at, 50 for median
+         * @return               Value at percentile (0 if histogram is empty)
+         */
+        int64_t percentile(double percentile) const;
+
+        uint64_t count() const;
+        int64_t min() const;
+        int64_t max() const;
+        double mean() const;
+        const std::string &getUnit() const;
+
+        /**
+         * @brief Clears all recorded values, must not run concurrently with record().
+         */
+        void reset();
+    };
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include "metrics.h"
+
+namespace tless {
+    static volatile std::sig_atomic_t dumpSignalled = 0;
+
+    static void onDumpSignal(int) {
+        dumpSignalled = 1;
+    }
+
+    static const double PERCENTILES[] = {50, 90, 99, 99.9};
+    static const char *PERCENTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+
+    Histogram &Metrics::histogram(const std::string &name, const char *unit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_ptr<Histogram> &histogram = histograms[name];
+
+        if (!histogram) {
+            histogram.reset(new Histogram(unit));
+        }
+
+        return *histogram;
+    }
+
+    Histogram &Metrics::latency(const std::string &name) {
+        return histogram(name, "us");
+    }
+
+    Histogram &Metrics::counter(const std::string &name) {
+        return histogram(name, "");
+    }
+
+    void Metrics::recordSeconds(const std::string &name, double seconds) {
+        latency(name).record(static_cast<int64_t>(seconds * 1e6 + 0.5));
+    }
+
+    void Metrics::recordCount(const std::string &name, int64_t count) {
+        counter(name).record(count);
+    }
+
+    void Metrics::writeJSON(std::ostream &os) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        os << "{" << std::endl;
+
+        for (auto it = histograms.begin(); it != histograms.end(); ++it) {
+            const Histogram &h = *it->second;
+            os << "  \"" << it->first << "\": {\"unit\": \"" << h.getUnit() << "\", \"count\": " << h.count()
+               << ", \"min\": " << h.min() << ", \"mean\": " << std::fixed << std::setprecision(2) << h.mean();
+
+            for (size_t p = 0; p < 4; ++p) {
+                os << ", \"" << PERCENTILE_NAMES[p] << "\": " << h.percentile(PERCENTILES[p]);
+            }
+
+            os << ", \"max\": " << h.max() << "}" << (std::next(it) != histograms.end() ? "," : "") << std::endl;
+        }
+
+        os << "}" << std::endl;
+    }
+
+    void Metrics::writeCSV(std::ostream &os) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        os << "name,unit,count,min,mean";
+        for (auto &name : PERCENTILE_NAMES) {
+            os << "," << name;
+        }
+        os << ",max" << std::endl;
+
+        for (auto &entry : histograms) {
+            const Histogram &h = *entry.second;
+            os << entry.first << "," << h.getUnit() << "," << h.count() << "," << h.min() << ","
+               << std::fixed << std::setprecision(2) << h.mean();
+
+            for (double percentile : PERCENTILES) {
+                os << "," << h.percentile(percentile);
+            }
+
+            os << "," << h.max() << std::endl;
+        }
+    }
+
+    bool Metrics::dump(const std::string &basePath) const {
+        std::ofstream json(basePath + ".json"), csv(basePath + ".csv");
+        if (!json.is_open() || !csv.is_open()) {
+            return false;
+        }
+
+        writeJSON(json);
+        writeCSV(csv);
+        return json.good() && csv.good();
+    }
+
+    void Metrics::dumpOnSignal(int signal) {
+#ifdef SIGUSR1
+        if (signal < 0) signal = SIGUSR1;
+#endif
+        if (signal >= 0) {
+            std::signal(signal, onDumpSignal);
+        }
+    }
+
+    bool Metrics::dumpRequested() {
+        if (!dumpSignalled) return false;
+
+        dumpSignalled = 0;
+        return true;
+    }
+}
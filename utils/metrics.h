@@ -0,0 +1,86 @@
+#ifndef VSB_SEMESTRAL_PROJECT_METRICS_H
+#define VSB_SEMESTRAL_PROJECT_METRICS_H
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <ostream>
+#include "histogram.h"
+
+namespace tless {
+    /**
+     * @brief Named histograms of detection metrics (stage latencies and counts) collected over the whole run.
+     *
+     * Histograms are created on first use and live as long as metrics do, so references returned by latency()
+     * and counter() can be kept and recorded into from any thread. Metrics can be dumped as JSON or CSV
+     * at the end of the run, or while running when the process receives a signal (see dumpOnSignal()).
+     */
+    class Metrics {
+    private:
+        mutable std::mutex mutex;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms; //!< Sorted by name, so dumps are stable
+
+        Histogram &histogram(const std::string &name, const char *unit);
+
+    public:
+        Metrics() = default;
+        Metrics(const Metrics &) = delete;
+        Metrics &operator=(const Metrics &) = delete;
+
+        /**
+         * @brief Returns histogram of latencies (in microseconds) with given name, created if it doesn't exist.
+         */
+        Histogram &latency(const std::string &name);
+
+        /**
+         * @brief Returns histogram of counts with given name, created if it doesn't exist.
+         */
+        Histogram &counter(const std::string &name);
+
+        /**
+         * @brief Records duration in seconds (e.g. Timer::elapsed()) into latency histogram with given name.
+         */
+        void recordSeconds(const std::string &name, double seconds);
+
+        /**
+         * @brief Records count into counter histogram with given name.
+         */
+        void recordCount(const std::string &name, int64_t count);
+
+        /**
+         * @brief Writes summary (count, min, mean, max and percentiles) of all histograms as JSON object.
+         */
+        void writeJSON(std::ostream &os) const;
+
+        /**
+         * @brief Writes summary of all histograms as CSV, one row per histogram.
+         */
+        void writeCSV(std::ostream &os) const;
+
+        /**
+         * @brief Writes JSON and CSV summaries to basePath.json and basePath.csv.
+         *
+         * @param[in] basePath Path of the dumps without extension
+         * @return             False if any of the files couldn't be written
+         */
+        bool dump(const std::string &basePath) const;
+
+        /**
+         * @brief Installs handler of given signal, that requests dump of metrics (see dumpRequested()).
+         *
+         * Handler only sets a flag, dumping itself is left to the detection loop, as nothing else is safe
+         * to do inside signal handler.
+         *
+         * @param[in] signal Signal to handle, SIGUSR1 by default
+         */
+        static void dumpOnSignal(int signal = -1);
+
+        /**
+         * @brief Returns true once after each received signal installed by dumpOnSignal().
+         */
+        static bool dumpRequested();
+    };
+}
+
+#endif
@@ -0,0 +1,526 @@
+#include "model_file.h"
+#include <fstream>
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "thread_pool.h"
+
+namespace tless {
+    static const char MODEL_MAGIC[8] = {'T', 'L', 'E', 'S', 'S', 'M', 'D', 'L'};
+    static const uint32_t MODEL_ENDIANNESS = 0x01020304;
+
+    static void writeAligned(std::ofstream &ofs, const void *src, size_t size) {
+        static const char zeros[8] = {0};
+
+        if (size > 0) {
+            ofs.write(reinterpret_cast<const char *>(src), size);
+        }
+
+        // Pad to 8B so that next record or array starts aligned
+        ofs.write(zeros, (8 - size % 8) % 8);
+    }
+
+    static void writeMat(std::ofstream &ofs, const cv::Mat &m) {
+        cv::Mat continuous = m.isContinuous() ? m : m.clone();
+
+        int32_t record[4] = {continuous.rows, continuous.cols, continuous.type(), 0};
+        writeAligned(ofs, record, sizeof(record));
+        writeAligned(ofs, continuous.data, continuous.total() * continuous.elemSize());
+    }
+
+    static size_t aligned(size_t size) {
+        return size + (8 - size % 8) % 8;
+    }
+
+    ModelFile::~ModelFile() {
+        close();
+    }
+
+    bool ModelFile::write(const std::string &path, const ClassifierCriteria &criteria, const std::vector<Template> &templates,
+                          const std::unordered_map<uint, size_t> &indices, const std::vector<HashTable> &tables) {
+        // Model is written aside and renamed over the old one, so processes mapping the old model never see partial file
+        const std::string tmpPath = path + ".tmp";
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open()) {
+            return false;
+        }
+
+        // Header is rewritten once all offsets are known
+        Header header;
+        std::memset(&header, 0, sizeof(Header));
+        std::memcpy(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+        header.version = VERSION;
+        header.endianness = MODEL_ENDIANNESS;
+        header.templatesCount = templates.size();
+        header.tablesCount = tables.size();
+        writeAligned(ofs, &header, sizeof(Header));
+
+        // Criteria
+        CriteriaRecord crit;
+        std::memset(&crit, 0, sizeof(CriteriaRecord));
+        crit.tripletGrid[0] = criteria.tripletGrid.width;
+        crit.tripletGrid[1] = criteria.tripletGrid.height;
+        crit.tablesCount = criteria.tablesCount;
+        crit.depthBinCount = criteria.depthBinCount;
+        crit.tablesTrainingMultiplier = criteria.tablesTrainingMultiplier;
+        crit.featurePointsCount = criteria.featurePointsCount;
+        crit.minMagnitude = criteria.minMagnitude;
+        crit.objectnessDiameterThreshold = criteria.objectnessDiameterThreshold;
+        crit.maxDepthDiff = criteria.maxDepthDiff;
+        crit.infoMinDepth = criteria.info.minDepth;
+        crit.infoMaxDepth = criteria.info.maxDepth;
+        crit.infoMinEdgels = criteria.info.minEdgels;
+        crit.infoDepthScaleFactor = criteria.info.depthScaleFactor;
+        crit.infoSmallestDiameter = criteria.info.smallestDiameter;
+        crit.infoSmallestTemplate[0] = criteria.info.smallestTemplate.width;
+        crit.infoSmallestTemplate[1] = criteria.info.smallestTemplate.height;
+        crit.infoLargestArea[0] = criteria.info.largestArea.width;
+        crit.infoLargestArea[1] = criteria.info.largestArea.height;
+        crit.depthDeviationFunCount = static_cast<uint32_t>(criteria.depthDeviationFun.size());
+
+        header.criteriaOffset = static_cast<uint64_t>(ofs.tellp());
+        writeAligned(ofs, &crit, sizeof(CriteriaRecord));
+        writeAligned(ofs, criteria.depthDeviationFun.data(), criteria.depthDeviationFun.size() * sizeof(cv::Vec2f));
+
+        // Templates, offsets table is filled afterwards
+        std::vector<uint64_t> offsets(templates.size(), 0);
+        assert(indices.size() == templates.size());
+        header.templatesOffset = static_cast<uint64_t>(ofs.tellp());
+        writeAligned(ofs, offsets.data(), offsets.size() * sizeof(uint64_t));
+
+        for (size_t i = 0; i < templates.size(); ++i) {
+            const Template &t = templates[i];
+            offsets[i] = static_cast<uint64_t>(ofs.tellp());
+
+            TemplateRecord rec;
+            std::memset(&rec, 0, sizeof(TemplateRecord));
+            rec.id = t.id;
+            rec.diameter = t.diameter;
+            rec.resizeRatio = t.resizeRatio;
+            rec.objArea = t.objArea;
+            rec.objBB[0] = t.objBB.x;
+            rec.objBB[1] = t.objBB.y;
+            rec.objBB[2] = t.objBB.width;
+            rec.objBB[3] = t.objBB.height;
+            rec.depthMedian = t.features.depthMedian;
+            rec.minDepth = t.minDepth;
+            rec.maxDepth = t.maxDepth;
+            rec.elev = t.camera.elev;
+            rec.azimuth = t.camera.azimuth;
+            rec.mode = t.camera.mode;
+            rec.fileNameLength = static_cast<uint32_t>(t.fileName.size());
+            rec.edgePointsCount = static_cast<uint32_t>(t.edgePoints.size());
+            rec.stablePointsCount = static_cast<uint32_t>(t.stablePoints.size());
+            rec.gradientsCount = static_cast<uint32_t>(t.features.gradients.size());
+            rec.normalsCount = static_cast<uint32_t>(t.features.normals.size());
+            rec.depthsCount = static_cast<uint32_t>(t.features.depths.size());
+            rec.hueCount = static_cast<uint32_t>(t.features.hue.size());
+
+            writeAligned(ofs, &rec, sizeof(TemplateRecord));
+            writeMat(ofs, t.camera.K);
+            writeMat(ofs, t.camera.R);
+            writeMat(ofs, t.camera.t);
+            writeAligned(ofs, t.edgePoints.data(), t.edgePoints.size() * sizeof(cv::Point));
+            writeAligned(ofs, t.stablePoints.data(), t.stablePoints.size() * sizeof(cv::Point));
+            writeAligned(ofs, t.features.depths.data(), t.features.depths.size() * sizeof(ushort));
+            writeAligned(ofs, t.features.gradients.data(), t.features.gradients.size());
+            writeAligned(ofs, t.features.normals.data(), t.features.normals.size());
+            writeAligned(ofs, t.features.hue.data(), t.features.hue.size());
+            writeAligned(ofs, t.fileName.data(), t.fileName.size());
+        }
+
+        std::streampos end = ofs.tellp();
+        ofs.seekp(static_cast<std::streamoff>(header.templatesOffset));
+        writeAligned(ofs, offsets.data(), offsets.size() * sizeof(uint64_t));
+        ofs.seekp(end);
+
+        // Hash tables, only non-empty buckets are stored
+        offsets.assign(tables.size(), 0);
+        header.tablesOffset = static_cast<uint64_t>(ofs.tellp());
+        writeAligned(ofs, offsets.data(), offsets.size() * sizeof(uint64_t));
+
+        for (size_t i = 0; i < tables.size(); ++i) {
+            const HashTable &table = tables[i];
+            offsets[i] = static_cast<uint64_t>(ofs.tellp());
+
+            std::vector<int32_t> ranges;
+            std::vector<uint32_t> keys, starts, postings;
+
+            for (auto &range : table.binRanges) {
+                ranges.push_back(range.start);
+                ranges.push_back(range.end);
+            }
+
+            for (size_t key = 0; key < table.templates.size(); ++key) {
+                if (table.templates[key].empty()) continue;
+
+                keys.push_back(static_cast<uint32_t>(key));
+                starts.push_back(static_cast<uint32_t>(postings.size()));
+
+                for (auto *t : table.templates[key]) {
+                    assert(indices.count(t->id) > 0);
+                    postings.push_back(static_cast<uint32_t>(indices.at(t->id)));
+                }
+            }
+            starts.push_back(static_cast<uint32_t>(postings.size()));
+
+            TableRecord rec;
+            std::memset(&rec, 0, sizeof(TableRecord));
+            rec.size = table.size;
+            rec.triplet[0] = table.triplet.c.x;
+            rec.triplet[1] = table.triplet.c.y;
+            rec.triplet[2] = table.triplet.p1.x;
+            rec.triplet[3] = table.triplet.p1.y;
+            rec.triplet[4] = table.triplet.p2.x;
+            rec.triplet[5] = table.triplet.p2.y;
+            rec.binRangesCount = static_cast<uint32_t>(table.binRanges.size());
+            rec.bucketsCount = static_cast<uint32_t>(keys.size());
+            rec.postingsCount = postings.size();
+
+            writeAligned(ofs, &rec, sizeof(TableRecord));
+            writeAligned(ofs, ranges.data(), ranges.size() * sizeof(int32_t));
+            writeAligned(ofs, keys.data(), keys.size() * sizeof(uint32_t));
+            writeAligned(ofs, starts.data(), starts.size() * sizeof(uint32_t));
+            writeAligned(ofs, postings.data(), postings.size() * sizeof(uint32_t));
+        }
+
+        ofs.seekp(static_cast<std::streamoff>(header.tablesOffset));
+        writeAligned(ofs, offsets.data(), offsets.size() * sizeof(uint64_t));
+
+        // Rewrite header with final offsets
+        ofs.seekp(0);
+        writeAligned(ofs, &header, sizeof(Header));
+        ofs.close();
+
+        if (!ofs.good() || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ModelFile::open(const std::string &path) {
+        close();
+
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+            close();
+            return false;
+        }
+
+        length = static_cast<size_t>(st.st_size);
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close();
+            return false;
+        }
+
+        data = static_cast<const uchar *>(mapped);
+        std::memcpy(&header, data, sizeof(Header));
+
+        // Validate model file
+        if (std::memcmp(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0 || header.version != VERSION ||
+            header.endianness != MODEL_ENDIANNESS) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void ModelFile::close() {
+        if (data != nullptr) {
+            munmap(const_cast<uchar *>(data), length);
+            data = nullptr;
+        }
+
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+
+        length = 0;
+    }
+
+    const uchar *ModelFile::at(uint64_t offset, uint64_t size) const {
+        assert(data != nullptr);
+
+        // Written as subtraction so that corrupted offsets and sizes can't overflow
+        if (offset > length || size > length - offset) {
+            return nullptr;
+        }
+
+        return data + offset;
+    }
+
+    /**
+     * Reads matrix record at ptr, returns pointer right behind the record or nullptr if the record doesn't lie
+     * inside of [ptr, end) or isn't a valid matrix.
+     */
+    static const uchar *readMat(const uchar *ptr, const uchar *end, cv::Mat &m) {
+        int32_t record[4];
+        if (ptr == nullptr || static_cast<size_t>(end - ptr) < aligned(sizeof(record))) {
+            return nullptr;
+        }
+
+        std::memcpy(record, ptr, sizeof(record));
+        ptr += aligned(sizeof(record));
+
+        if (record[0] < 0 || record[1] < 0 || record[2] != CV_MAT_TYPE(record[2]) || CV_MAT_DEPTH(record[2]) > CV_64F) {
+            return nullptr;
+        }
+
+        if (static_cast<uint64_t>(record[0]) * static_cast<uint64_t>(record[1]) == 0) {
+            m = cv::Mat();
+            return ptr;
+        }
+
+        const uint64_t total = static_cast<uint64_t>(record[0]) * static_cast<uint64_t>(record[1]);
+        if (total > static_cast<uint64_t>(end - ptr) / CV_ELEM_SIZE(record[2])) {
+            return nullptr;
+        }
+
+        m.create(record[0], record[1], record[2]);
+        const size_t size = m.total() * m.elemSize();
+        std::memcpy(m.data, ptr, size);
+
+        return ptr + std::min<size_t>(aligned(size), static_cast<size_t>(end - ptr));
+    }
+
+    /**
+     * Reads array of count elements at ptr, returns pointer right behind the array or nullptr if the array doesn't
+     * lie inside of [ptr, end).
+     */
+    template<typename T>
+    static const uchar *readArray(const uchar *ptr, const uchar *end, uint64_t count, std::vector<T> &dst) {
+        if (ptr == nullptr || count > static_cast<uint64_t>(end - ptr) / sizeof(T)) {
+            return nullptr;
+        }
+
+        const size_t size = count * sizeof(T);
+        dst.resize(count);
+
+        if (count > 0) {
+            std::memcpy(dst.data(), ptr, size);
+        }
+
+        return ptr + std::min<size_t>(aligned(size), static_cast<size_t>(end - ptr));
+    }
+
+    bool ModelFile::readTemplate(uint64_t offset, Template &t) const {
+        TemplateRecord rec;
+        const uchar *end = data + length;
+        const uchar *ptr = at(offset, aligned(sizeof(TemplateRecord)));
+        if (ptr == nullptr) {
+            return false;
+        }
+
+        std::memcpy(&rec, ptr, sizeof(TemplateRecord));
+        ptr += aligned(sizeof(TemplateRecord));
+
+        t.id = rec.id;
+        t.diameter = rec.diameter;
+        t.resizeRatio = rec.resizeRatio;
+        t.objArea = rec.objArea;
+        t.objBB = cv::Rect(rec.objBB[0], rec.objBB[1], rec.objBB[2], rec.objBB[3]);
+        t.features.depthMedian = rec.depthMedian;
+        t.minDepth = rec.minDepth;
+        t.maxDepth = rec.maxDepth;
+        t.camera.elev = rec.elev;
+        t.camera.azimuth = rec.azimuth;
+        t.camera.mode = rec.mode;
+
+        ptr = readMat(ptr, end, t.camera.K);
+        ptr = readMat(ptr, end, t.camera.R);
+        ptr = readMat(ptr, end, t.camera.t);
+        ptr = readArray(ptr, end, rec.edgePointsCount, t.edgePoints);
+        ptr = readArray(ptr, end, rec.stablePointsCount, t.stablePoints);
+        ptr = readArray(ptr, end, rec.depthsCount, t.features.depths);
+        ptr = readArray(ptr, end, rec.gradientsCount, t.features.gradients);
+        ptr = readArray(ptr, end, rec.normalsCount, t.features.normals);
+        ptr = readArray(ptr, end, rec.hueCount, t.features.hue);
+
+        // Whole record must lie inside of the mapped file
+        if (ptr == nullptr || rec.fileNameLength > static_cast<size_t>(end - ptr)) {
+            return false;
+        }
+
+        t.fileName.assign(reinterpret_cast<const char *>(ptr), rec.fileNameLength);
+        return true;
+    }
+
+    bool ModelFile::readTable(uint64_t offset, std::vector<Template> &templates, const std::vector<int> &remap, HashTable &table) const {
+        TableRecord rec;
+        const uchar *end = data + length;
+        const uchar *ptr = at(offset, aligned(sizeof(TableRecord)));
+        if (ptr == nullptr) {
+            return false;
+        }
+
+        std::memcpy(&rec, ptr, sizeof(TableRecord));
+        ptr += aligned(sizeof(TableRecord));
+
+        table.size = 0;
+        table.triplet.c = cv::Point(rec.triplet[0], rec.triplet[1]);
+        table.triplet.p1 = cv::Point(rec.triplet[2], rec.triplet[3]);
+        table.triplet.p2 = cv::Point(rec.triplet[4], rec.triplet[5]);
+
+        std::vector<int32_t> ranges;
+        std::vector<uint32_t> keys, starts, postings;
+        ptr = readArray(ptr, end, static_cast<uint64_t>(rec.binRangesCount) * 2, ranges);
+        ptr = readArray(ptr, end, rec.bucketsCount, keys);
+        ptr = readArray(ptr, end, static_cast<uint64_t>(rec.bucketsCount) + 1, starts);
+        ptr = readArray(ptr, end, rec.postingsCount, postings);
+        if (ptr == nullptr) {
+            return false;
+        }
+
+        // Buckets must be valid keys and reference consecutive non-overlapping ranges of postings
+        for (size_t b = 0; b < keys.size(); ++b) {
+            if (keys[b] >= table.templates.size() || starts[b] > starts[b + 1] || starts[b + 1] > postings.size()) {
+                return false;
+            }
+        }
+
+        for (uint32_t posting : postings) {
+            if (posting >= remap.size()) {
+                return false;
+            }
+        }
+
+        table.binRanges.clear();
+        for (size_t i = 0; i < rec.binRangesCount; ++i) {
+            table.binRanges.emplace_back(ranges[2 * i], ranges[2 * i + 1]);
+        }
+
+        // Postings are template indices in the file, remapped to indices of loaded templates (-1 if not loaded)
+        for (size_t b = 0; b < keys.size(); ++b) {
+            auto &bucket = table.templates[keys[b]];
+            bucket.reserve(starts[b + 1] - starts[b]);
+
+            for (uint32_t p = starts[b]; p < starts[b + 1]; ++p) {
+                if (remap[postings[p]] < 0) continue;
+
+                bucket.push_back(&templates[remap[postings[p]]]);
+                table.size++;
+            }
+        }
+
+        return true;
+    }
+
+    bool ModelFile::read(cv::Ptr<ClassifierCriteria> criteria, std::vector<Template> &templates,
+                         std::vector<HashTable> &tables, const std::vector<uint> &objectIds) const {
+        assert(data != nullptr);
+        const uchar *end = data + length;
+        templates.clear();
+        tables.clear();
+
+        // Criteria are applied only when the whole file is valid
+        CriteriaRecord crit;
+        std::vector<cv::Vec2f> depthDeviationFun;
+        const uchar *ptr = at(header.criteriaOffset, aligned(sizeof(CriteriaRecord)));
+        if (ptr == nullptr) {
+            return false;
+        }
+
+        std::memcpy(&crit, ptr, sizeof(CriteriaRecord));
+        ptr += aligned(sizeof(CriteriaRecord));
+        if (readArray(ptr, end, crit.depthDeviationFunCount, depthDeviationFun) == nullptr) {
+            return false;
+        }
+
+        // Select templates of requested objects, only ids are read from their records
+        std::vector<uint64_t> offsets, selected;
+        if (readArray(at(header.templatesOffset, 0), end, header.templatesCount, offsets) == nullptr) {
+            return false;
+        }
+
+        std::vector<int> remap(offsets.size(), -1);
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            uint32_t id;
+            const uchar *record = at(offsets[i], sizeof(uint32_t));
+            if (record == nullptr) {
+                return false;
+            }
+
+            std::memcpy(&id, record, sizeof(uint32_t));
+            if (objectIds.empty() || std::find(objectIds.begin(), objectIds.end(), Template::objectId(id)) != objectIds.end()) {
+                remap[i] = static_cast<int>(selected.size());
+                selected.push_back(offsets[i]);
+            }
+        }
+
+        // Templates
+        std::atomic<bool> valid(true);
+        templates.resize(selected.size());
+        const auto templatesSize = static_cast<int>(selected.size());
+
+        ThreadPool::global().parallelFor(0, templatesSize, [&](int i) {
+            if (!readTemplate(selected[i], templates[i])) {
+                valid = false;
+            }
+        }, 64);
+
+        // Hash tables
+        if (!valid || readArray(at(header.tablesOffset, 0), end, header.tablesCount, offsets) == nullptr) {
+            templates.clear();
+            return false;
+        }
+
+        tables.resize(offsets.size());
+        const auto tablesSize = static_cast<int>(offsets.size());
+
+        ThreadPool::global().parallelFor(0, tablesSize, [&](int i) {
+            if (!readTable(offsets[i], templates, remap, tables[i])) {
+                valid = false;
+            }
+        });
+
+        if (!valid) {
+            templates.clear();
+            tables.clear();
+            return false;
+        }
+
+        criteria->tripletGrid = cv::Size(crit.tripletGrid[0], crit.tripletGrid[1]);
+        criteria->tablesCount = crit.tablesCount;
+        criteria->depthBinCount = crit.depthBinCount;
+        criteria->tablesTrainingMultiplier = crit.tablesTrainingMultiplier;
+        criteria->featurePointsCount = crit.featurePointsCount;
+        criteria->minMagnitude = crit.minMagnitude;
+        criteria->objectnessDiameterThreshold = crit.objectnessDiameterThreshold;
+        criteria->maxDepthDiff = crit.maxDepthDiff;
+        criteria->info.minDepth = crit.infoMinDepth;
+        criteria->info.maxDepth = crit.infoMaxDepth;
+        criteria->info.minEdgels = crit.infoMinEdgels;
+        criteria->info.depthScaleFactor = crit.infoDepthScaleFactor;
+        criteria->info.smallestDiameter = crit.infoSmallestDiameter;
+        criteria->info.smallestTemplate = cv::Size(crit.infoSmallestTemplate[0], crit.infoSmallestTemplate[1]);
+        criteria->info.largestArea = cv::Size(crit.infoLargestArea[0], crit.infoLargestArea[1]);
+        criteria->depthDeviationFun = std::move(depthDeviationFun);
+
+        return true;
+    }
+
+    size_t ModelFile::templatesCount() const {
+        return data != nullptr ? header.templatesCount : 0;
+    }
+
+    size_t ModelFile::tablesCount() const {
+        return data != nullptr ? header.tablesCount : 0;
+    }
+}
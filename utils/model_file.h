@@ -0,0 +1,156 @@
+#ifndef VSB_SEMESTRAL_PROJECT_MODEL_FILE_H
+#define VSB_SEMESTRAL_PROJECT_MODEL_FILE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <opencv2/core/mat.hpp>
+#include "../core/template.h"
+#include "../core/hash_table.h"
+#include "../core/classifier_criteria.h"
+
+namespace tless {
+    /**
+     * @brief Versioned binary container of trained classifier (criteria, template features and frozen hash tables).
+     *
+     * All records have fixed size and are followed by their flat arrays, every record and array starts at 8B aligned
+     * offset from the beginning of the file. Hash table postings reference templates by their index in the file, so
+     * no id lookup is needed when tables are decoded. File is memory mapped read-only and arrays are copied out of
+     * the mapping in parallel, no parsing is involved.
+     *
+     * Decoded model is not zero-copy: Template and HashTable own their arrays (training and yml loading fill them
+     * as well), so each process holds its own copy of features and postings and only the page cache of the file
+     * is shared. Layout already allows arrays to be referenced in place, which would need Template and HashTable
+     * to hold views into the mapping and the model to keep the mapping alive.
+     *
+     * Layout:
+     *  - Header
+     *  - Criteria record followed by depthDeviationFun
+     *  - Template offsets table (uint64 x templatesCount) and template records
+     *  - Hash table offsets table (uint64 x tablesCount) and hash table records
+     */
+    class ModelFile {
+    public:
+        static const uint32_t VERSION = 1;
+
+    private:
+        struct Header {
+            char magic[8]; //!< TLESSMDL
+            uint32_t version;
+            uint32_t endianness; //!< 0x01020304 in byte order of the machine that wrote the file
+            uint64_t criteriaOffset;
+            uint64_t templatesCount, templatesOffset;
+            uint64_t tablesCount, tablesOffset;
+        };
+
+        struct CriteriaRecord {
+            int32_t tripletGrid[2];
+            uint32_t tablesCount, depthBinCount, tablesTrainingMultiplier, featurePointsCount;
+            float minMagnitude, objectnessDiameterThreshold;
+            uint16_t maxDepthDiff, infoMinDepth, infoMaxDepth, pad;
+            int32_t infoMinEdgels;
+            float infoDepthScaleFactor, infoSmallestDiameter;
+            int32_t infoSmallestTemplate[2], infoLargestArea[2];
+            uint32_t depthDeviationFunCount; //!< followed by depthDeviationFun (float x 2 x count)
+        };
+
+        struct TemplateRecord {
+            uint32_t id;
+            float diameter, resizeRatio, objArea;
+            int32_t objBB[4];
+            uint16_t depthMedian, minDepth, maxDepth, pad;
+            int32_t elev, azimuth, mode;
+            uint32_t fileNameLength, edgePointsCount, stablePointsCount;
+            uint32_t gradientsCount, normalsCount, depthsCount, hueCount;
+            // followed by camera K, R, t matrices (int32 rows, cols, type, pad + data), edgePoints, stablePoints, depths, gradients, normals, hue and fileName
+        };
+
+        struct TableRecord {
+            uint64_t size;
+            int32_t triplet[6]; //!< c, p1, p2
+            uint32_t binRangesCount;
+            uint32_t bucketsCount; //!< Number of non-empty buckets
+            uint64_t postingsCount;
+            // followed by binRanges (int32 x 2), bucket keys (uint32), bucket starts (uint32 x bucketsCount + 1) and postings (uint32 template indices)
+        };
+
+        int fd = -1;
+        const uchar *data = nullptr;
+        size_t length = 0;
+        Header header;
+
+        /**
+         * @brief Returns pointer to the mapped file at given offset, or nullptr if requested bytes don't lie inside the file.
+         */
+        const uchar *at(uint64_t offset, uint64_t size) const;
+
+        /**
+         * @brief Decodes template record at given offset, returns false if the record is truncated or corrupted.
+         */
+        bool readTemplate(uint64_t offset, Template &t) const;
+
+        /**
+         * @brief Decodes hash table record at given offset, returns false if the record is truncated or corrupted.
+         */
+        bool readTable(uint64_t offset, std::vector<Template> &templates, const std::vector<int> &remap, HashTable &table) const;
+
+    public:
+        ModelFile() = default;
+        ModelFile(const ModelFile &) = delete;
+        ModelFile &operator=(const ModelFile &) = delete;
+        ~ModelFile();
+
+        /**
+         * @brief Writes trained classifier into binary model file.
+         *
+         * Hash tables may point to any copy of the templates, postings are resolved to template indices by template ids.
+         * File is written to path.tmp first and renamed to path once it's complete, existing model at path is left
+         * untouched if writing fails.
+         *
+         * @param[in] path      Path of the resulting model file
+         * @param[in] criteria  Trained classifier criteria
+         * @param[in] templates Trained templates
+         * @param[in] indices   Map of template ids to their index in templates array (see HashTable::indexTemplates)
+         * @param[in] tables    Trained hash tables
+         * @return              False if the model file couldn't be written
+         */
+        static bool write(const std::string &path, const ClassifierCriteria &criteria, const std::vector<Template> &templates,
+                          const std::unordered_map<uint, size_t> &indices, const std::vector<HashTable> &tables);
+
+        /**
+         * @brief Memory maps model file read-only and validates its header.
+         *
+         * @param[in] path Path to the model file
+         * @return         False if file doesn't exist or isn't a valid model file of this version
+         */
+        bool open(const std::string &path);
+
+        /**
+         * @brief Unmaps the model file, called automatically on destruction.
+         */
+        void close();
+
+        /**
+         * @brief Decodes criteria, templates and hash tables from mapped model file.
+         *
+         * Only trained criteria params are overwritten (same as when loading classifier.yml.gz). Templates array is
+         * resized to hold all templates before tables are decoded, hash tables then point into this array.
+         * Every count, offset and posting is validated against the mapped file, so truncated or corrupted file
+         * is rejected as a whole, leaving criteria untouched and templates and tables empty.
+         *
+         * @param[in,out] criteria  Criteria to fill with trained params
+         * @param[out]    templates Decoded templates
+         * @param[out]    tables    Decoded hash tables
+         * @param[in]     objectIds Ids of objects to decode, postings of other objects are dropped (empty to decode all objects)
+         * @return                  False if model file is truncated or corrupted
+         */
+        bool read(cv::Ptr<ClassifierCriteria> criteria, std::vector<Template> &templates, std::vector<HashTable> &tables,
+                  const std::vector<uint> &objectIds = {}) const;
+
+        size_t templatesCount() const;
+        size_t tablesCount() const;
+    };
+}
+
+#endif
@@ -1,8 +1,12 @@
 #include "parser.h"
+#include <iostream>
 #include "../processing/processing.h"
 #include "../objdetect/matcher.h"
 #include "../objdetect/hasher.h"
+#include "../objdetect/pyramid_planner.h"
 #include "../core/classifier_criteria.h"
+#include "thread_pool.h"
+#include "buffer_allocator.h"
 
 namespace tless {
     void Parser::parseObject(const std::string &basePath, std::vector<Template> &templates, const std::vector<uint> &indices) {
@@ -97,16 +101,19 @@ namespace tless {
         quantizedNormals(t.srcDepth, t.srcNormals, t.camera.fx(), t.camera.fy(), localMax, static_cast<int>(criteria->maxDepthDiff / t.resizeRatio));
     }
 
-    Scene Parser::parseScene(const std::string &basePath, int index, float scaleFactor, int levelsUp, int levelsDown) {
-        Scene scene;
+    bool Parser::parseFrame(const std::string &basePath, int index, Frame &frame) {
         std::ostringstream oss;
         oss << std::setw(4) << std::setfill('0') << index;
         oss << ".png";
 
         // Load Scene images
-        scene.id = static_cast<uint>(index);
-        cv::Mat srcRGB = cv::imread(basePath + "rgb/" + oss.str(), CV_LOAD_IMAGE_COLOR);
-        cv::Mat srcDepth = cv::imread(basePath + "depth/" + oss.str(), CV_LOAD_IMAGE_UNCHANGED);
+        frame.id = static_cast<uint>(index);
+        frame.rgb = cv::imread(basePath + "rgb/" + oss.str(), CV_LOAD_IMAGE_COLOR);
+        frame.depth = cv::imread(basePath + "depth/" + oss.str(), CV_LOAD_IMAGE_UNCHANGED);
+
+        if (frame.rgb.empty() || frame.depth.empty()) {
+            return false;
+        }
 
         // Load scene info
         std::string infoIndex = "scene_" + std::to_string(index);
@@ -123,80 +130,281 @@ namespace tless {
         infoNode["elev"] >> elev;
         infoNode["mode"] >> mode;
 
-        cv::Mat K = cv::Mat(3, 3, CV_32FC1, vCamK.data());
-        cv::Mat R = cv::Mat(3, 3, CV_32FC1, vCamRw2c.data());
-        cv::Mat t = cv::Mat(3, 1, CV_32FC1, vCamTw2c.data());
+        frame.K = cv::Mat(3, 3, CV_32FC1, vCamK.data()).clone();
+        frame.R = cv::Mat(3, 3, CV_32FC1, vCamRw2c.data()).clone();
+        frame.t = cv::Mat(3, 1, CV_32FC1, vCamTw2c.data()).clone();
         fs.release();
 
-        // Reserve size for scene pyramid
-        scene.pyramid.resize(levelsDown + levelsUp + 1);
+        return true;
+    }
+
+    Scene Parser::parseScene(const std::string &basePath, int index, float scaleFactor, int levelsUp, int levelsDown) {
+        Frame frame;
+        parseFrame(basePath, index, frame);
+
+        return createScene(frame, scaleFactor, levelsUp, levelsDown);
+    }
+
+    Scene Parser::createScene(const Frame &frame, float scaleFactor, int levelsUp, int levelsDown) {
+        Scene scene;
+        createScene(frame, scaleFactor, levelsUp, levelsDown, scene);
+
+        return scene;
+    }
 
-        // Create down levels of pyramid
-        float scale = 1.0f;
+    void Parser::createScene(const Frame &frame, float scaleFactor, int levelsUp, int levelsDown, Scene &scene) {
+        assert(!frame.rgb.empty());
+        assert(frame.depth.type() == CV_16UC1);
+        assert(frame.K.type() == CV_32FC1);
+
+        scene.id = frame.id;
+        const cv::Mat &srcRGB = frame.rgb, &srcDepth = frame.depth;
+        const cv::Mat &K = frame.K, &R = frame.R, &t = frame.t;
+
+        // Levels of previous frame are kept with their buffers, only images of previous frame are dropped
+        const int levels = levelsDown + levelsUp + 1;
+        std::vector<cv::Mat> rgbs(levels), depths(levels);
+        std::vector<float> scales(levels);
+        scene.pyramid.resize(levels);
+
+        // Compute scales of all levels
+        scales[levelsDown] = 1.0f;
         for (int i = levelsDown - 1; i >= 0; --i) {
-            scale /= scaleFactor;
-            scene.pyramid[i] = createPyramid(scale, srcRGB, srcDepth, K, R, t);
+            scales[i] = scales[i + 1] / scaleFactor;
+        }
+        for (int i = levelsDown + 1; i < levels; ++i) {
+            scales[i] = scales[i - 1] * scaleFactor;
         }
 
-        // Create current level of pyramid
-        scene.pyramid[levelsDown] = createPyramid(1.0f, srcRGB, srcDepth, K, R, t);
+        cv::MatAllocator *allocator = BufferAllocator::get(criteria->pyrHugePages);
+        for (int i = 0; i < levels; ++i) {
+            scene.pyramid[i].reset(scales[i], allocator);
+        }
+
+        // Pick levels that can contain objects, skipped levels are left with empty images
+        std::vector<bool> feasible(levels, true);
+        if (criteria->pyrPruneLevels) {
+            PyramidPlanner planner(criteria);
+            feasible = planner.plan(srcDepth, scales);
 
-        // Create up levels of pyramid
-        scale = 1.0f;
-        for (int i = levelsDown + 1; i <= (levelsDown + levelsUp); ++i) {
-            scale *= scaleFactor;
-            scene.pyramid[i] = createPyramid(scale, srcRGB, srcDepth, K, R, t);
+            // Full resolution level is always built, it's the root of resampling and is used for visualization
+            feasible[levelsDown] = true;
         }
 
-        return scene;
+        // Current level takes ownership of loaded images, no need to clone them
+        rgbs[levelsDown] = srcRGB;
+        depths[levelsDown] = srcDepth;
+
+        // Resample each level from its closest built neighbour into its buffers, down and up chains don't depend on each other
+        auto resample = [&](int i, int prev) {
+            ScenePyramid::Buffers &buffers = scene.pyramid[i].buffers;
+            resizePyramid(scales[i], srcRGB.size(), rgbs[prev], depths[prev], buffers.rgb, buffers.resized);
+            rgbs[i] = buffers.rgb;
+            depths[i] = buffers.resized;
+        };
+
+        ThreadPool::global().parallelFor(0, 2, [&](int chain) {
+            if (chain == 0) {
+                for (int i = levelsDown - 1, prev = levelsDown; i >= 0; --i) {
+                    if (!feasible[i]) continue;
+                    resample(i, prev);
+                    prev = i;
+                }
+            } else {
+                for (int i = levelsDown + 1, prev = levelsDown; i < levels; ++i) {
+                    if (!feasible[i]) continue;
+                    resample(i, prev);
+                    prev = i;
+                }
+            }
+        });
+
+        // Create levels of pyramid, starting with the largest ones as they take the most time
+        const bool lazy = criteria->pyrLazyFeatures;
+        const bool pooled = criteria->pyrPooledFeatures && !lazy;
+        ThreadPool::global().parallelFor(0, levels, [&](int j) {
+            const int i = levels - 1 - j;
+            if (!feasible[i]) return;
+
+            createPyramid(scene.pyramid[i], rgbs[i], depths[i], K, R, t);
+
+            // Lazy levels get their features computed during classification, only if needed
+            if (lazy) return;
+
+            computeColors(scene.pyramid[i]);
+            if (pooled && i < levelsDown && feasible[i + 1]) return;
+
+            computeGradients(scene.pyramid[i]);
+            computeNormals(scene.pyramid[i]);
+        });
+
+        // Pool quantized features of smaller levels from their finer neighbour
+        if (pooled) {
+            for (int i = levelsDown - 1; i >= 0; --i) {
+                if (!feasible[i] || !feasible[i + 1]) continue;
+
+                ScenePyramid &level = scene.pyramid[i], &finer = scene.pyramid[i + 1];
+                poolQuantized(finer.srcNormals, level.buffers.normals, level.srcDepth.size());
+                poolQuantized(finer.srcGradients, level.buffers.gradients, level.srcRGB.size());
+                level.srcNormals = level.buffers.normals;
+                level.srcGradients = level.buffers.gradients;
+            }
+
+            if (criteria->pyrPooledAccuracy) {
+                pooledFeaturesAccuracy(scene);
+            }
+        }
     }
 
-    ScenePyramid Parser::createPyramid(float scale, const cv::Mat &rgb, const cv::Mat &depth,
-                                       const cv::Mat &K, const cv::Mat &R, const cv::Mat &t) {
-        // Create camera
-        Camera camera;
-        camera.K = K.clone();
-        camera.R = R.clone();
-        camera.t = t.clone();
+    /**
+     * Expands roi by margin in all directions and clips it to image of given size.
+     * Empty roi is treated as the whole image.
+     */
+    static cv::Rect expandROI(const cv::Rect &roi, int margin, const cv::Size &size) {
+        const cv::Rect image(cv::Point(0, 0), size);
+        if (roi.area() == 0) return image;
 
-        // Recalculate K matrix based on scale
-        camera.K.at<float>(0, 0) *= scale;
-        camera.K.at<float>(0, 2) *= scale;
-        camera.K.at<float>(1, 1) *= scale;
-        camera.K.at<float>(1, 2) *= scale;
+        return cv::Rect(roi.x - margin, roi.y - margin, roi.width + 2 * margin, roi.height + 2 * margin) & image;
+    }
 
-        // Create scene pyramid
-        ScenePyramid pyramid(scale);
-        pyramid.camera = std::move(camera);
+    /**
+     * Prepares buffer of given size and type and returns view of the region, that is to be filled in place.
+     * Buffers always have the size of the whole level, so regions changing between frames don't reallocate them.
+     * If zero is set, area outside of the region is zeroed.
+     */
+    static cv::Mat regionBuffer(cv::Mat &buffer, const cv::Size &size, int type, const cv::Rect &region, bool zero = true) {
+        buffer.create(size, type);
+        if (zero && region.size() != size) {
+            buffer.setTo(0);
+        }
 
-        if (scale != 1.0f) {
-            cv::resize(rgb, pyramid.srcRGB, cv::Size(), scale, scale);
-            cv::resize(depth, pyramid.srcDepth, cv::Size(), scale, scale);
+        return buffer(region);
+    }
 
-            // Recalculate depth values
-            pyramid.srcDepth = pyramid.srcDepth / scale;
-        } else {
-            pyramid.srcRGB = rgb.clone();
-            pyramid.srcDepth = depth.clone();
+    void Parser::computeNormals(ScenePyramid &pyramid, const cv::Rect &roi) {
+        assert(!pyramid.srcDepth.empty());
+        if (!pyramid.srcNormals.empty()) return;
+
+        // Margin covers normal patch size and median filter applied on computed normals
+        const cv::Rect region = expandROI(roi, 7, pyramid.srcDepth.size());
+        float ratio = depthNormalizationFactor(criteria->info.maxDepth, criteria->depthDeviationFun);
+        ScenePyramid::Buffers &buffers = pyramid.buffers;
+
+        const cv::Size size = pyramid.srcDepth.size();
+        cv::Mat normals = regionBuffer(buffers.normals, size, CV_8UC1, region);
+        cv::Mat rawNormals = regionBuffer(buffers.rawNormals, size, CV_8UC1, region, false);
+        quantizedNormals(pyramid.srcDepth(region), normals, pyramid.camera.fx(), pyramid.camera.fy(),
+                         static_cast<int>(criteria->info.maxDepth / ratio), static_cast<int>(criteria->maxDepthDiff / pyramid.scale),
+                         rawNormals);
+
+        pyramid.srcNormals = buffers.normals;
+    }
+
+    void Parser::computeGradients(ScenePyramid &pyramid, const cv::Rect &roi) {
+        assert(!pyramid.srcRGB.empty());
+        if (!pyramid.srcGradients.empty()) return;
+
+        // Margin covers sobel kernel
+        const cv::Rect region = expandROI(roi, 1, pyramid.srcRGB.size());
+        ScenePyramid::Buffers &buffers = pyramid.buffers;
+
+        const cv::Size size = pyramid.srcRGB.size();
+        cv::Mat gradients = regionBuffer(buffers.gradients, size, CV_8UC1, region);
+
+        // Intermediate images are views of the same region in their buffers
+        cv::Mat bgr[3], mags[3], angles[3];
+        for (int i = 0; i < 3; ++i) {
+            bgr[i] = regionBuffer(buffers.bgr[i], size, CV_8UC1, region, false);
+            mags[i] = regionBuffer(buffers.mags[i], size, CV_32FC1, region, false);
+            angles[i] = regionBuffer(buffers.angles[i], size, CV_32FC1, region, false);
         }
+        cv::Mat gradX = regionBuffer(buffers.gradX, size, CV_32FC1, region, false);
+        cv::Mat gradY = regionBuffer(buffers.gradY, size, CV_32FC1, region, false);
 
-        // Smooth out depth image
-        cv::medianBlur(pyramid.srcDepth, pyramid.srcDepth, 5);
+        quantizedGradients(pyramid.srcRGB(region), gradients, criteria->minMagnitude, bgr, gradX, gradY, mags, angles);
+
+        pyramid.srcGradients = buffers.gradients;
+    }
+
+    void Parser::computeColors(ScenePyramid &pyramid, const cv::Rect &roi) {
+        assert(!pyramid.srcRGB.empty());
+        if (!pyramid.srcHue.empty()) return;
+
+        const cv::Rect region = expandROI(roi, 0, pyramid.srcRGB.size());
+        ScenePyramid::Buffers &buffers = pyramid.buffers;
 
         // Convert to gray and hsv
-        cv::Mat hsv;
-        cv::cvtColor(pyramid.srcRGB, pyramid.srcGray, CV_BGR2GRAY);
-        cv::cvtColor(pyramid.srcRGB, hsv, CV_BGR2HSV);
+        const cv::Size size = pyramid.srcRGB.size();
+        cv::Mat gray = regionBuffer(buffers.gray, size, CV_8UC1, region);
+        cv::Mat hue = regionBuffer(buffers.hue, size, CV_8UC1, region);
+        cv::Mat hsv = regionBuffer(buffers.hsv, size, CV_8UC3, region, false);
+        cv::cvtColor(pyramid.srcRGB(region), gray, CV_BGR2GRAY);
+        cv::cvtColor(pyramid.srcRGB(region), hsv, CV_BGR2HSV);
 
         // Normalize HSV
-        normalizeHSV(hsv, pyramid.srcHue);
+        normalizeHSV(hsv, hue);
+
+        pyramid.srcGray = buffers.gray;
+        pyramid.srcHue = buffers.hue;
+    }
 
-        // Generate quantized normals and orientations
+    void Parser::pooledFeaturesAccuracy(const Scene &scene) {
         float ratio = depthNormalizationFactor(criteria->info.maxDepth, criteria->depthDeviationFun);
-        quantizedGradients(pyramid.srcRGB, pyramid.srcGradients, criteria->minMagnitude);
-        quantizedNormals(pyramid.srcDepth, pyramid.srcNormals, pyramid.camera.fx(), pyramid.camera.fy(),
-                         static_cast<int>(criteria->info.maxDepth / ratio), static_cast<int>(criteria->maxDepthDiff / scale));
+        std::cout << "Pooled features accuracy (scene " << scene.id << "):" << std::endl;
+
+        for (size_t i = 0; i < scene.pyramid.size(); ++i) {
+            const ScenePyramid &level = scene.pyramid[i];
+            if (level.srcDepth.empty()) continue;
+
+            Camera camera = level.camera;
+
+            // Recompute features using the original kernels
+            cv::Mat normals, gradients;
+            quantizedGradients(level.srcRGB, gradients, criteria->minMagnitude);
+            quantizedNormals(level.srcDepth, normals, camera.fx(), camera.fy(),
+                             static_cast<int>(criteria->info.maxDepth / ratio), static_cast<int>(criteria->maxDepthDiff / level.scale));
+
+            std::cout << "  |_ scale " << level.scale
+                      << " -> normals: " << quantizedAgreement(level.srcNormals, normals)
+                      << ", gradients: " << quantizedAgreement(level.srcGradients, gradients) << std::endl;
+        }
+    }
+
+    void Parser::resizePyramid(float scale, const cv::Size &srcSize, const cv::Mat &rgb, const cv::Mat &depth, cv::Mat &dstRGB, cv::Mat &dstDepth) {
+        // Compute size from the full resolution image, so rounding errors don't accumulate across the chain
+        cv::Size size(cvRound(srcSize.width * scale), cvRound(srcSize.height * scale));
+
+        cv::resize(rgb, dstRGB, size);
+        cv::resize(depth, dstDepth, size);
+    }
+
+    void Parser::createPyramid(ScenePyramid &pyramid, const cv::Mat &rgb, const cv::Mat &depth,
+                               const cv::Mat &K, const cv::Mat &R, const cv::Mat &t) {
+        const float scale = pyramid.scale;
+
+        // Create camera, matrices are copied into the ones of previous frame
+        Camera &camera = pyramid.camera;
+        K.copyTo(camera.K);
+        R.copyTo(camera.R);
+        t.copyTo(camera.t);
+
+        // Recalculate K matrix based on scale
+        camera.K.at<float>(0, 0) *= scale;
+        camera.K.at<float>(0, 2) *= scale;
+        camera.K.at<float>(1, 1) *= scale;
+        camera.K.at<float>(1, 2) *= scale;
+
+        // Images are already resampled to given scale, only recalculate depth values and smooth out depth image
+        pyramid.srcRGB = rgb;
+        if (scale != 1.0f) {
+            // Resampled depth is owned by the level and no longer needed by the resampling chain
+            depth.convertTo(pyramid.buffers.resized, -1, 1.0 / scale);
+            cv::medianBlur(pyramid.buffers.resized, pyramid.buffers.depth, 5);
+        } else {
+            // Input depth may be owned by the caller, never filter it in place
+            cv::medianBlur(depth, pyramid.buffers.depth, 5);
+        }
 
-        return pyramid;
+        pyramid.srcDepth = pyramid.buffers.depth;
     }
-}
\ No newline at end of file
+}
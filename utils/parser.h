@@ -32,17 +32,34 @@ namespace tless {
         void parseCriteriaAndNormals(Template &t);
 
         /**
-         * @brief Creates one level of scene pyramid, by scaling src images and updating camera intristics
-         *
-         * @param[in] scale Current scale of the image pyramid
-         * @param[in] rgb   Input RGB image
-         * @param[in] depth Input Depth Image (16-bit)
-         * @param[in] K     Camera intristic params
-         * @param[in] R     Camera rotation matrix
-         * @param[in] t     Camera translation vector
-         * @return          New level of Scene pyramid at given scale
+         * @brief Resamples images of neighbouring pyramid level to given scale.
+         *
+         * Size of the destination is always computed from the full resolution image, so sizes of the levels
+         * are the same as if they were resized directly from the full resolution image.
+         *
+         * @param[in]  scale    Scale of the destination level (relative to the full resolution image)
+         * @param[in]  srcSize  Size of the full resolution image
+         * @param[in]  rgb      RGB image of the neighbouring level
+         * @param[in]  depth    Depth image of the neighbouring level (16-bit, depth values not rescaled)
+         * @param[out] dstRGB   Resampled RGB image
+         * @param[out] dstDepth Resampled depth image (depth values not rescaled)
+         */
+        void resizePyramid(float scale, const cv::Size &srcSize, const cv::Mat &rgb, const cv::Mat &depth, cv::Mat &dstRGB, cv::Mat &dstDepth);
+
+        /**
+         * @brief Creates one level of scene pyramid from resampled src images and updates camera intristics
+         *
+         * Only RGB and smoothed depth images are created, derived images are computed by computeColors,
+         * computeGradients and computeNormals. Smoothed depth is written into buffers of the level.
+         *
+         * @param[in,out] pyramid Level to build (reset to its scale for current frame)
+         * @param[in]     rgb     Input RGB image, already resampled to given scale
+         * @param[in]     depth   Input Depth Image (16-bit), already resampled to given scale, depth values are rescaled here
+         * @param[in]     K       Camera intristic params
+         * @param[in]     R       Camera rotation matrix
+         * @param[in]     t       Camera translation vector
          */
-        ScenePyramid createPyramid(float scale, const cv::Mat &rgb, const cv::Mat &depth, const cv::Mat &K, const cv::Mat &R, const cv::Mat &t);
+        void createPyramid(ScenePyramid &pyramid, const cv::Mat &rgb, const cv::Mat &depth, const cv::Mat &K, const cv::Mat &R, const cv::Mat &t);
 
     public:
         Parser(cv::Ptr<ClassifierCriteria> criteria) : criteria(criteria) {};
@@ -61,12 +78,91 @@ namespace tless {
         /**
          * @brief Parses scene info, images, computes quantized normals and gradients.
          *
+         * Pyramid is built as a cascade, each level is resampled from its closest neighbour towards the
+         * full resolution level. Features of all levels are then computed in parallel. If criteria.pyrPooledFeatures
+         * is set, quantized normals and gradients of smaller levels are majority pooled from the finer level.
+         * If criteria.pyrLazyFeatures is set, only RGB and depth images are created and the rest has to be computed
+         * on demand by computeNormals, computeGradients and computeColors (pooling is not applied in that case, so
+         * pooled features require criteria.pyrLazyFeatures = false). If criteria.pyrPooledAccuracy is set as well,
+         * agreement of pooled features is printed for each scene (see pooledFeaturesAccuracy).
+         * If criteria.pyrPruneLevels is set, levels rejected by PyramidPlanner are not built at all and contain
+         * only their scale (all images are empty), full resolution level is always built.
+         *
          * @param[in]     basePath Base path to scene folder with info.yml and rgb, depth folders
          * @param[in]     index    Current index of a scene image
          * @param[in]     scaleFactor    Current scale of image scale pyramid
          * @return                 Parsed scene object
          */
         Scene parseScene(const std::string &basePath, int index, float scaleFactor, int levelsUp, int levelsDown);
+
+        /**
+         * @brief Loads scene images and camera params of one T-LESS scene frame.
+         *
+         * @param[in]  basePath Base path to scene folder with info.yml and rgb, depth folders
+         * @param[in]  index    Index of a scene image
+         * @param[out] frame    Loaded frame
+         * @return              False if scene images don't exist
+         */
+        static bool parseFrame(const std::string &basePath, int index, Frame &frame);
+
+        /**
+         * @brief Builds scene pyramid from frame in memory, the same way as parseScene (see parseScene).
+         *
+         * Frame images are only read, full resolution level shares RGB image with the frame.
+         *
+         * @param[in] frame       Frame with RGB, 16-bit depth images and 3x3 float intrinsics matrix K (R, t are optional)
+         * @param[in] scaleFactor Current scale of image scale pyramid
+         * @return                Scene with built pyramid
+         */
+        Scene createScene(const Frame &frame, float scaleFactor, int levelsUp, int levelsDown);
+
+        /**
+         * @brief Rebuilds scene pyramid of previous frame in place (see createScene).
+         *
+         * Levels keep their buffers (see ScenePyramid::Buffers), which are allocated only for the first frame
+         * or when the resolution changes, so building pyramid of steady stream of frames doesn't allocate any images.
+         * Buffers are allocated with BufferAllocator (backed by huge pages if criteria.pyrHugePages is set). Images of
+         * the previous frame are overwritten, so scene must not be used by anyone else.
+         *
+         * @param[in]     frame       Frame with RGB, 16-bit depth images and 3x3 float intrinsics matrix K (R, t are optional)
+         * @param[in]     scaleFactor Current scale of image scale pyramid
+         * @param[in,out] scene       Scene of previous frame (or empty scene) to rebuild
+         */
+        void createScene(const Frame &frame, float scaleFactor, int levelsUp, int levelsDown, Scene &scene);
+
+        /**
+         * @brief Computes quantized surface normals of pyramid level, if they weren't computed yet.
+         *
+         * @param[in,out] pyramid Pyramid level with depth image
+         * @param[in]     roi     Region to compute normals in (rest of the image is set to 0), empty for whole image
+         */
+        void computeNormals(ScenePyramid &pyramid, const cv::Rect &roi = cv::Rect());
+
+        /**
+         * @brief Computes quantized gradient orientations of pyramid level, if they weren't computed yet.
+         *
+         * @param[in,out] pyramid Pyramid level with RGB image
+         * @param[in]     roi     Region to compute gradients in (rest of the image is set to 0), empty for whole image
+         */
+        void computeGradients(ScenePyramid &pyramid, const cv::Rect &roi = cv::Rect());
+
+        /**
+         * @brief Computes gray and normalized hue images of pyramid level, if they weren't computed yet.
+         *
+         * @param[in,out] pyramid Pyramid level with RGB image
+         * @param[in]     roi     Region to compute images in (rest of the image is set to 0), empty for whole image
+         */
+        void computeColors(ScenePyramid &pyramid, const cv::Rect &roi = cv::Rect());
+
+        /**
+         * @brief Prints agreement of quantized features in each pyramid level with features recomputed by original kernels.
+         *
+         * Used to evaluate accuracy of pooled features (criteria.pyrPooledFeatures), levels that were not pooled
+         * should always report agreement of 1.
+         *
+         * @param[in] scene Parsed scene to evaluate
+         */
+        void pooledFeaturesAccuracy(const Scene &scene);
     };
 }
 
@@ -0,0 +1,65 @@
+#include <cassert>
+#include "task_graph.h"
+#include "thread_pool.h"
+
+namespace tless {
+    size_t TaskGraph::add(std::function<void()> task, const std::vector<size_t> &dependencies) {
+        const size_t index = nodes.size();
+        nodes.emplace_back();
+        nodes[index].task = std::move(task);
+        nodes[index].dependencies = static_cast<int>(dependencies.size());
+
+        for (auto &dependency : dependencies) {
+            assert(dependency < index);
+            nodes[dependency].successors.push_back(index);
+        }
+
+        return index;
+    }
+
+    void TaskGraph::spawn(size_t i) {
+        ThreadPool::global().submit([this, i] {
+            nodes[i].task();
+
+            // Last finished dependency spawns the successor
+            for (auto &successor : nodes[i].successors) {
+                if (--pending[successor] == 0) {
+                    spawn(successor);
+                }
+            }
+
+            // Graph may be destroyed once remaining reaches 0, only the pool is touched afterwards
+            if (--remaining == 0) {
+                ThreadPool::global().notifyWaiting();
+            }
+        });
+    }
+
+    void TaskGraph::run() {
+        if (nodes.empty()) return;
+
+        pending.reset(new std::atomic<int>[nodes.size()]);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            pending[i] = nodes[i].dependencies;
+        }
+
+        remaining = nodes.size();
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (nodes[i].dependencies == 0) {
+                spawn(i);
+            }
+        }
+
+        // Calling thread executes tasks as well until whole graph finished
+        ThreadPool::global().waitUntil([this] { return remaining == 0; });
+    }
+
+    void TaskGraph::clear() {
+        nodes.clear();
+        pending.reset();
+    }
+
+    size_t TaskGraph::size() const {
+        return nodes.size();
+    }
+}
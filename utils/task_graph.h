@@ -0,0 +1,58 @@
+#ifndef VSB_SEMESTRAL_PROJECT_TASK_GRAPH_H
+#define VSB_SEMESTRAL_PROJECT_TASK_GRAPH_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+namespace tless {
+    /**
+     * @brief Directed acyclic graph of tasks executed on the shared thread pool.
+     *
+     * Task is submitted as soon as all of its dependencies finished, so independent chains of tasks overlap instead
+     * of being separated by barriers. Tasks may split their work further by ThreadPool::parallelFor.
+     */
+    class TaskGraph {
+    private:
+        struct Node {
+            std::function<void()> task;
+            std::vector<size_t> successors;
+            int dependencies = 0;
+        };
+
+        std::vector<Node> nodes;
+        std::unique_ptr<std::atomic<int>[]> pending; //!< Number of unfinished dependencies of each node in current run
+        std::atomic<size_t> remaining{0}; //!< Number of unfinished nodes in current run
+
+        void spawn(size_t i);
+
+    public:
+        TaskGraph() = default;
+        TaskGraph(const TaskGraph &) = delete;
+        TaskGraph &operator=(const TaskGraph &) = delete;
+
+        /**
+         * @brief Adds task to the graph.
+         *
+         * @param[in] task         Task to execute
+         * @param[in] dependencies Indices of tasks that have to finish before this task starts (already added)
+         * @return                 Index of added task
+         */
+        size_t add(std::function<void()> task, const std::vector<size_t> &dependencies = {});
+
+        /**
+         * @brief Executes all tasks respecting their dependencies and waits until all of them finished.
+         */
+        void run();
+
+        /**
+         * @brief Removes all tasks from the graph.
+         */
+        void clear();
+
+        size_t size() const;
+    };
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include <cassert>
+#include "thread_pool.h"
+#include "tracer.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace tless {
+    // Index of the worker queue owned by current thread, valid only if current thread is a worker of workerPool
+    static thread_local const ThreadPool *workerPool = nullptr;
+    static thread_local size_t workerIndex = 0;
+
+    ThreadPool::~ThreadPool() {
+        stop();
+    }
+
+    // Settings of the global pool, used when it starts
+    static std::mutex globalMutex;
+    static std::atomic<bool> globalStarted{false};
+    static size_t globalThreads = 0;
+    static bool globalPin = false;
+
+    static size_t resolveThreads(size_t threads) {
+        return threads > 0 ? threads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    ThreadPool &ThreadPool::global() {
+        static ThreadPool pool;
+
+        if (!globalStarted) {
+            std::lock_guard<std::mutex> lock(globalMutex);
+            if (!globalStarted) {
+                pool.configure(globalThreads, globalPin);
+                globalStarted = true;
+            }
+        }
+
+        return pool;
+    }
+
+    bool ThreadPool::configureGlobal(size_t threads, bool pin) {
+        {
+            std::lock_guard<std::mutex> lock(globalMutex);
+            if (!globalStarted) {
+                globalThreads = threads;
+                globalPin = pin;
+                return true;
+            }
+        }
+
+        const ThreadPool &pool = global();
+        return pool.threads == resolveThreads(threads) && pool.pinned == pin;
+    }
+
+    void ThreadPool::configure(size_t threads, bool pin) {
+        threads = resolveThreads(threads);
+        if (threads == this->threads && pin == pinned) return;
+
+        stop();
+        start(threads, pin);
+    }
+
+    void ThreadPool::start(size_t threads, bool pin) {
+        assert(threads > 0);
+        this->threads = threads;
+        this->pinned = pin;
+        stopping = false;
+
+        // Calling thread is one of the threads, without workers callers serve the only queue themselves
+        const size_t count = threads - 1;
+        queues.clear();
+        for (size_t i = 0; i < std::max<size_t>(count, 1); ++i) {
+            queues.emplace_back(new Queue());
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            workers.emplace_back(&ThreadPool::work, this, i);
+
+#ifdef __linux__
+            // First core is left for the calling thread
+            if (pin) {
+                const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET((i + 1) % cores, &set);
+                pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpu_set_t), &set);
+            }
+#endif
+        }
+    }
+
+    void ThreadPool::stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        workers.clear();
+    }
+
+    size_t ThreadPool::size() const {
+        return threads;
+    }
+
+    void ThreadPool::submit(Task task) {
+        assert(!queues.empty());
+
+        // Workers push to their own queue, other threads spread tasks over all queues
+        const size_t index = (workerPool == this) ? workerIndex : next++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        ++pending;
+
+        // Lock makes sure that worker checking for pending tasks doesn't miss the notification
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    void ThreadPool::notifyWaiting() {
+        // Same as in submit, waiter checking its condition under the lock doesn't miss the notification
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_all();
+    }
+
+    bool ThreadPool::take(Task &task) {
+        const bool worker = (workerPool == this);
+        const size_t count = queues.size();
+        const size_t first = worker ? workerIndex : next % count;
+
+        // Own queue is used as a stack, as the most recent tasks have the warmest data
+        if (worker) {
+            Queue &own = *queues[first];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                --pending;
+                return true;
+            }
+        }
+
+        // Steal the oldest task from other queues
+        for (size_t i = worker ? 1 : 0; i < count; ++i) {
+            Queue &victim = *queues[(first + i) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --pending;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool ThreadPool::runPending() {
+        if (pending == 0) return false;
+
+        Task task;
+        if (!take(task)) return false;
+
+        task();
+        return true;
+    }
+
+    void ThreadPool::work(size_t index) {
+        workerPool = this;
+        workerIndex = index;
+        Tracer::global().nameThread("worker " + std::to_string(index));
+        Task task;
+
+        while (true) {
+            if (take(task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            // Sleep until there is work, queued tasks are finished before stopping
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || pending > 0; });
+            if (stopping && pending == 0) return;
+        }
+    }
+}
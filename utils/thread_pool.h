@@ -0,0 +1,183 @@
+#ifndef VSB_SEMESTRAL_PROJECT_THREAD_POOL_H
+#define VSB_SEMESTRAL_PROJECT_THREAD_POOL_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+namespace tless {
+    /**
+     * @brief Work-stealing thread pool shared by all parallel stages of training and detection.
+     *
+     * Each worker owns a queue of tasks, it takes tasks from the back of its own queue and steals from the front
+     * of other queues once it runs out of work. Thread that waits for submitted work (parallelFor, TaskGraph::run)
+     * executes queued tasks meanwhile and sleeps once there is nothing to take, so parallel loops can be nested
+     * freely and any thread of the embedding application can call into the pool. Idle workers sleep, so the pool
+     * doesn't compete with thread pools of the embedding application when there is no work. Pool configured with
+     * a single thread has no workers and runs all work on calling threads.
+     */
+    class ThreadPool {
+    public:
+        typedef std::function<void()> Task;
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<Queue>> queues; //!< Queue of each worker (single queue served by callers if there are no workers)
+        std::atomic<size_t> pending{0}; //!< Number of queued tasks
+        std::atomic<size_t> next{0}; //!< Queue to put next task submitted from outside of the pool to
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        size_t threads = 0;
+        bool pinned = false;
+
+        ThreadPool() = default;
+
+        /**
+         * @brief Restarts pool with given number of threads, must not be called while pool is in use.
+         */
+        void configure(size_t threads, bool pin);
+        void start(size_t threads, bool pin);
+        void stop();
+        void work(size_t index);
+
+        /**
+         * @brief Takes task from the back of own queue (if called from worker) or steals it from front of other queues.
+         */
+        bool take(Task &task);
+
+    public:
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        ~ThreadPool();
+
+        /**
+         * @brief Returns pool used by all stages, started on first use with settings passed to configureGlobal.
+         */
+        static ThreadPool &global();
+
+        /**
+         * @brief Sets threads of the global pool, takes effect only if the pool was not started yet.
+         *
+         * Running pool is never restarted, as other threads may be in the middle of parallel work on it.
+         *
+         * @param[in] threads Number of threads running the work including the calling thread (0 for all hardware threads)
+         * @param[in] pin     Pin each worker to its own CPU core (Linux only)
+         * @return            False if the pool is already running with different settings (they are kept)
+         */
+        static bool configureGlobal(size_t threads = 0, bool pin = false);
+
+        /**
+         * @brief Returns number of threads running the work including the calling thread.
+         */
+        size_t size() const;
+
+        /**
+         * @brief Queues task for execution, task has to be waited for by the caller (see runPending).
+         *
+         * @param[in] task Task to execute
+         */
+        void submit(Task task);
+
+        /**
+         * @brief Executes one queued task on the calling thread.
+         *
+         * @return False if there was no queued task
+         */
+        bool runPending();
+
+        /**
+         * @brief Executes queued tasks on the calling thread until done() returns true, sleeps while there is none.
+         *
+         * Whoever makes done() true has to call notifyWaiting afterwards, otherwise the caller may sleep forever.
+         *
+         * @param[in] done Condition to wait for, called concurrently with tasks finishing
+         */
+        template<typename Done>
+        void waitUntil(Done done) {
+            while (!done()) {
+                if (runPending()) continue;
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wake.wait(lock, [&] { return done() || pending > 0; });
+            }
+
+            // Submit notification might have woken this thread instead of a worker, pass it on
+            if (pending > 0) {
+                wake.notify_one();
+            }
+        }
+
+        /**
+         * @brief Wakes threads sleeping in waitUntil to check their condition again.
+         */
+        void notifyWaiting();
+
+        /**
+         * @brief Calls fn(i) for each i in [begin, end) in parallel and waits until all calls finished.
+         *
+         * Indices are handed out dynamically in chunks of grain consecutive indices. Calling thread processes
+         * indices as well, so no worker thread is needed to make progress.
+         *
+         * @param[in] begin First index
+         * @param[in] end   Index after the last index
+         * @param[in] fn    Function to call for each index
+         * @param[in] grain Number of consecutive indices processed at once
+         */
+        template<typename Fn>
+        void parallelFor(int begin, int end, Fn fn, int grain = 1) {
+            if (begin >= end) return;
+            grain = std::max(grain, 1);
+            const int chunks = (end - begin + grain - 1) / grain;
+            const int helpers = std::min(chunks, static_cast<int>(size())) - 1;
+
+            // Nothing to share
+            if (helpers <= 0) {
+                for (int i = begin; i < end; ++i) {
+                    fn(i);
+                }
+
+                return;
+            }
+
+            std::atomic<int> cursor{begin}, running{helpers};
+            auto loop = [&] {
+                int from;
+                while ((from = cursor.fetch_add(grain)) < end) {
+                    const int to = std::min(from + grain, end);
+                    for (int i = from; i < to; ++i) {
+                        fn(i);
+                    }
+                }
+            };
+
+            for (int h = 0; h < helpers; ++h) {
+                submit([&] {
+                    loop();
+
+                    // Stack frame may be gone once running reaches 0, only the pool is touched afterwards
+                    if (--running == 0) {
+                        notifyWaiting();
+                    }
+                });
+            }
+
+            // Helpers reference this stack frame, execute other queued tasks until all of them finished
+            loop();
+            waitUntil([&] { return running == 0; });
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include <fstream>
+#include "tracer.h"
+
+namespace tless {
+    Tracer &Tracer::global() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    Tracer::ThreadBuffer &Tracer::threadBuffer() {
+        static thread_local ThreadBuffer *buffer = nullptr;
+
+        // Buffer is registered on first span of the thread and owned by tracer, so it outlives the thread
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.emplace_back(new ThreadBuffer());
+            buffer = buffers.back().get();
+            buffer->tid = static_cast<uint32_t>(buffers.size());
+        }
+
+        return *buffer;
+    }
+
+    void Tracer::enable(bool enable) {
+        enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    int64_t Tracer::now() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - epoch).count();
+    }
+
+    void Tracer::nameThread(const std::string &name) {
+        ThreadBuffer &buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    void Tracer::record(const char *name, int64_t begin, int64_t end, int arg) {
+        ThreadBuffer &buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back({name, begin, end - begin, arg});
+    }
+
+    bool Tracer::write(const std::string &path, bool clear) {
+        std::ofstream ofs(path);
+        if (!ofs.is_open()) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ofs << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+        bool first = true;
+
+        for (auto &buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+
+            if (!buffer->name.empty()) {
+                ofs << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+                    << ", \"args\": {\"name\": \"" << buffer->name << "\"}}";
+                first = false;
+            }
+
+            for (auto &event : buffer->events) {
+                ofs << (first ? "" : ",\n") << "{\"name\": \"" << event.name << "\", \"cat\": \"tless\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                    << buffer->tid << ", \"ts\": " << event.begin << ", \"dur\": " << event.duration;
+                if (event.arg >= 0) {
+                    ofs << ", \"args\": {\"level\": " << event.arg << "}";
+                }
+                ofs << "}";
+                first = false;
+            }
+
+            if (clear) {
+                buffer->events.clear();
+            }
+        }
+
+        ofs << std::endl << "]}" << std::endl;
+        return ofs.good();
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef VSB_SEMESTRAL_PROJECT_TRACER_H
+#define VSB_SEMESTRAL_PROJECT_TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace tless {
+    /**
+     * @brief Collects timeline of spans from all threads and writes it as Chrome trace-event JSON.
+     *
+     * Written file can be opened in chrome://tracing or ui.perfetto.dev, each thread has its own track, so that
+     * stalls of thread pool workers and overlaps of pyramid levels are visible. While disabled, spans cost a single
+     * relaxed atomic load. Each thread records into its own buffer, buffers are kept after their thread exits.
+     */
+    class Tracer {
+    public:
+        struct Event {
+            const char *name; //!< Static string, only the pointer is stored
+            int64_t begin, duration; //!< Microseconds since tracer creation
+            int arg; //!< Pyramid level, or -1 if not related to any level
+        };
+
+    private:
+        struct ThreadBuffer {
+            std::mutex mutex; //!< Taken by owning thread when recording and by write()
+            std::vector<Event> events;
+            std::string name;
+            uint32_t tid;
+        };
+
+        typedef std::chrono::steady_clock clock;
+        const clock::time_point epoch = clock::now();
+        std::atomic<bool> enabled{false};
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+        Tracer() = default;
+        ThreadBuffer &threadBuffer();
+
+    public:
+        Tracer(const Tracer &) = delete;
+        Tracer &operator=(const Tracer &) = delete;
+
+        /**
+         * @brief Returns process-wide tracer.
+         */
+        static Tracer &global();
+
+        /**
+         * @brief Starts (or stops) recording of spans, already recorded events are kept.
+         */
+        void enable(bool enable = true);
+
+        bool isEnabled() const {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Returns current time in microseconds since tracer creation.
+         */
+        int64_t now() const;
+
+        /**
+         * @brief Names current thread in the trace (e.g. "worker 2").
+         */
+        void nameThread(const std::string &name);
+
+        /**
+         * @brief Records finished span of current thread.
+         */
+        void record(const char *name, int64_t begin, int64_t end, int arg = -1);
+
+        /**
+         * @brief Writes all recorded events as Chrome trace-event JSON (complete "X" events and thread names).
+         *
+         * @param[in] path  Path of the resulting JSON file
+         * @param[in] clear Drop written events, so next write contains only new ones
+         * @return          False if file couldn't be written
+         */
+        bool write(const std::string &path, bool clear = true);
+    };
+
+    /**
+     * @brief Scoped span of the trace, recorded from construction to destruction if tracer is enabled.
+     *
+     * Usage: TraceSpan span("quantizedNormals"); at the beginning of traced scope.
+     */
+    class TraceSpan {
+    private:
+        const char *name;
+        int64_t begin;
+        int arg;
+
+    public:
+        /**
+         * @param[in] name Static name of the span
+         * @param[in] arg  Pyramid level the span belongs to (-1 for none)
+         */
+        explicit TraceSpan(const char *name, int arg = -1)
+                : name(name), begin(Tracer::global().isEnabled() ? Tracer::global().now() : -1), arg(arg) {}
+
+        TraceSpan(const TraceSpan &) = delete;
+        TraceSpan &operator=(const TraceSpan &) = delete;
+
+        ~TraceSpan() {
+            if (begin >= 0) {
+                Tracer::global().record(name, begin, Tracer::global().now(), arg);
+            }
+        }
+    };
+}
+
+#endif
@@ -40,21 +40,21 @@ namespace tless {
         putText(dst, label, origin, fontFace, scale, fColor, thickness, CV_AA);
     }
 
-    void Visualizer::windowCandidates(const cv::Mat &src, cv::Mat &dst, Window &window) {
+    void Visualizer::windowCandidates(const cv::Mat &src, cv::Mat &dst, Window &window, const std::vector<Template> &templates) {
         std::ostringstream oss;
         dst = src.clone();
 
         // Create template mosaic of found candidates
-        if (!window.candidates.empty()) {
+        if (window.hasCandidates()) {
             // Define grid, offsets and initialize tpl mosaic matrix
             const int offset = 8, topOffset = 25;
-            int x, y, width = window.candidates[0]->objBB.width;
+            int x, y, width = templates[window.candidates[0].index].objBB.width;
             int sizeX = width + 2 * offset, sizeY = width + offset + topOffset;
-            auto gridSize = static_cast<int>(std::ceil(std::sqrt(window.candidates.size())));
+            auto gridSize = static_cast<int>(std::ceil(std::sqrt(window.candidatesCount)));
             cv::Mat tplMosaic = cv::Mat::zeros(gridSize * sizeY, gridSize * sizeX, CV_8UC3);
 
-            for (int i = 0; i < window.candidates.size(); ++i) {
-                Template *candidate = window.candidates[i];
+            for (int i = 0; i < window.candidatesCount; ++i) {
+                const Template *candidate = &templates[window.candidates[i].index];
 
                 // Calculate x, y and rect inside defined mosaic grid
                 x = (i % gridSize);
@@ -65,18 +65,21 @@ namespace tless {
                 cv::Mat tplSrc = loadTemplateSrc(*candidate);
                 tplSrc.copyTo(tplMosaic(rect));
 
+#ifdef TLESS_TRACE_VOTES
                 // Draw triplets
-                for (auto &triplet : window.triplets[i]) {
+                for (int t = 0; window.triplets != nullptr && t < window.triplets[i].count; ++t) {
+                    const Triplet &triplet = window.triplets[i].triplets[t];
                     cv::line(tplMosaic, rect.tl() + triplet.c, rect.tl() + triplet.p1, cv::Scalar(0, 180, 0), 1, CV_AA);
                     cv::line(tplMosaic, rect.tl() + triplet.c, rect.tl() + triplet.p2, cv::Scalar(0, 180, 0), 1, CV_AA);
                     cv::circle(tplMosaic, rect.tl() + triplet.c, 2, cv::Scalar(0, 255, 0), -1, CV_AA);
                     cv::circle(tplMosaic, rect.tl() + triplet.p1, 2, cv::Scalar(255, 0, 0), -1, CV_AA);
                     cv::circle(tplMosaic, rect.tl() + triplet.p2, 2, cv::Scalar(0, 0, 255), -1, CV_AA);
                 }
+#endif
 
                 // Annotate templates in mosaic
                 cv::rectangle(tplMosaic, rect, cv::Scalar(200, 200, 200), 1);
-                oss << "Votes: " << window.votes[i];
+                oss << "Votes: " << window.candidates[i].votes;
                 label(tplMosaic, oss.str(), cv::Point(rect.x, rect.y + rect.height + 15));
                 oss.str("");
             }
@@ -89,7 +92,7 @@ namespace tless {
 
         // Set labels
         if (settings[SETTINGS_INFO]) {
-            oss << "candidates: " << window.candidates.size();
+            oss << "candidates: " << window.candidatesCount;
             label(dst, oss.str(), window.tl() + cv::Point(5, 16));
             oss.str("");
             oss << "edgels: " << window.edgels;
@@ -97,8 +100,8 @@ namespace tless {
         }
     }
 
-    void Visualizer::windowsCandidates(const ScenePyramid &scene, std::vector<Window> &windows, int wait,
-                                       const char *title) {
+    void Visualizer::windowsCandidates(const ScenePyramid &scene, std::vector<Window> &windows, const std::vector<Template> &templates,
+                                       int wait, const char *title) {
         const auto winSize = static_cast<const int>(windows.size());
         std::ostringstream oss;
         cv::Mat result;
@@ -114,7 +117,7 @@ namespace tless {
             }
 
             // Vizualize window candidates
-            windowCandidates(result, result, windows[i]);
+            windowCandidates(result, result, windows[i], templates);
 
             // Title
             if (settings[SETTINGS_TITLE]) {
@@ -487,7 +490,7 @@ namespace tless {
         cv::Scalar cGreen(0, 255, 0), cRed(0, 0, 255), cBlue(255, 0, 0), cWhite(255, 255, 255), cGray(90, 90, 90);
         cv::Point offsetStart(-patchOffset, -patchOffset), offsetEnd(patchOffset, patchOffset);
         auto winSize = static_cast<int>(windows.size());
-        auto canSize = static_cast<int>(window.candidates.size());
+        auto canSize = window.candidatesCount;
 
         // Load scene and define offsets
         const int offset = 15;
@@ -33,11 +33,14 @@ namespace tless {
         /**
          * @brief Vizualizes candidates for given window along with matched triplets and number of votes.
          *
-         * @param[in]  src    8-bit rgb image of the scene we want to vizualize hashing on
-         * @param[out] dst    Destination image annotated with current window
-         * @param[in]  window Sliding window that passed hashing verification
+         * Triplets are drawn only in builds recording them (see TLESS_TRACE_VOTES in window.h).
+         *
+         * @param[in]  src       8-bit rgb image of the scene we want to vizualize hashing on
+         * @param[out] dst       Destination image annotated with current window
+         * @param[in]  window    Sliding window that passed hashing verification
+         * @param[in]  templates Templates of the model, referenced by candidate indices
          */
-        void windowCandidates(const cv::Mat &src, cv::Mat &dst, Window &window);
+        void windowCandidates(const cv::Mat &src, cv::Mat &dst, Window &window, const std::vector<Template> &templates);
 
     public:
         static const int KEY_UP = 0, KEY_DOWN = 1, KEY_LEFT = 2, KEY_RIGHT = 3, KEY_SPACEBAR = 32,
@@ -66,13 +69,14 @@ namespace tless {
         /**
          * @brief Vizualizes candidates for given window array along with matched triplets and number of votes.
          *
-         * @param[in] scene   Scene object we want to vizualize hashing on
-         * @param[in] windows Array of sliding windows that passed hashing verification and contain candidates
-         * @param[in] wait    Optional wait time in waitKey() function
-         * @param[in] title   Optional image window title
+         * @param[in] scene     Scene object we want to vizualize hashing on
+         * @param[in] windows   Array of sliding windows that passed hashing verification and contain candidates
+         * @param[in] templates Templates of the model, referenced by candidate indices
+         * @param[in] wait      Optional wait time in waitKey() function
+         * @param[in] title     Optional image window title
          */
-        void windowsCandidates(const ScenePyramid &scene, std::vector<Window> &windows, int wait = 0,
-                               const char *title = nullptr);
+        void windowsCandidates(const ScenePyramid &scene, std::vector<Window> &windows, const std::vector<Template> &templates,
+                               int wait = 0, const char *title = nullptr);
 
         /**
          * @brief Vizualizes window locations after objectness detection has been performed.